@@ -1,8 +1,10 @@
 #include "Actor.h"
 #include "StudentWorld.h"
 #include "GameConstants.h"
+#include "AllocationTracker.h"
 #include <list>
 #include <cmath>
+#include <cstddef>
 // Students:  Add code to this file, Actor.h, StudentWorld.h, and StudentWorld.cpp
 
 
@@ -10,6 +12,33 @@
 // Actor //
 ///////////
 
+#ifdef ZD_TRACK_ALLOCATIONS
+namespace
+{
+	const std::size_t SIZE_HEADER = alignof(std::max_align_t);
+}
+
+void* Actor::operator new(std::size_t size)
+{
+	ALLOCATION_PHASE(PHASE_SPAWN);
+	char* block = static_cast<char*>(::operator new(SIZE_HEADER + size));
+	*reinterpret_cast<std::size_t*>(block) = size;
+	return block + SIZE_HEADER;
+}
+
+void Actor::operator delete(void* p)
+{
+	::operator delete(static_cast<char*>(p) - SIZE_HEADER);
+}
+
+std::size_t Actor::allocatedSize(const Actor* a)
+{
+	// The header is in front of the whole object, which a may point into
+	const char* start = static_cast<const char*>(dynamic_cast<const void*>(a));
+	return *reinterpret_cast<const std::size_t*>(start - SIZE_HEADER);
+}
+#endif
+
 // Modify nextX and nextY with new coords corresponding to a move of distToMove pixels in direction d
 // Returns false if movement is blocked in direction d
 bool Agent::calculateNextMove(double& nextX, double& nextY, double distToMove, Direction d)
@@ -37,6 +66,13 @@ bool Agent::calculateNextMove(double& nextX, double& nextY, double distToMove, D
 
 	return true;
 }
+void Actor::setDead()
+{
+	if (!m_isAlive) return;
+	m_isAlive = false;
+	getWorld()->recordActorDead();
+}
+
 bool Actor::isActorAt(double x, double y) const
 {
 	return (getX() == x && getY() == y);
@@ -99,15 +135,34 @@ bool Agent::move(Direction d, double distance)
 // Humans //
 ////////////
 
+Human::~Human()
+{
+	getWorld()->cancelTimer(m_infectionTimer);
+}
+
+// Starts the infection countdown; being vomited on again while infected changes nothing
 void Human::beVomitedOnIfAppropriate()
 {
+	if (m_isInfected) return;
+
 	m_isInfected = true;
+	m_infectedTick = getWorld()->currentTick();
+
+	// The infection count passes 500 on the 501st tick after this one
+	m_infectionTimer = getWorld()->scheduleTimer(501, [this]() { succumbToInfection(); });
 }
 
 void Human::clearInfection()
 {
 	m_isInfected = false;
-	m_infectionCount = 0;
+	getWorld()->cancelTimer(m_infectionTimer);
+	m_infectionTimer = TimerWheel::NO_TIMER;
+}
+
+int Human::infectionCount() const
+{
+	if (!m_isInfected) return 0;
+	return getWorld()->currentTick() - m_infectedTick;
 }
 
 //////////////
@@ -118,31 +173,22 @@ void Penelope::doSomething()
 {
 	if (!isAlive()) return;
 
-	if (isInfected()) incrementInfectionCount();
-
-	if (infectionCount() > 500)
-	{
-		kill();
-		return;
-	}
-
+	// Act on as many queued keys as the input policy allows this tick
+	int limit = getWorld()->inputsPerTick();
 	int ch;
-	if (getWorld()->getKey(ch))
+	Direction d;
+	bool moved = false;
+	for (int handled = 0; (limit == ALL_QUEUED_INPUTS || handled < limit) && getWorld()->getKey(ch); handled++)
 	{
+		if (directionForKey(ch, d))
+		{
+			move(d);
+			moved = true;
+			continue;
+		}
+
 		switch (ch)
 		{
-		case KEY_PRESS_LEFT:
-			move(left);
-			break;
-		case KEY_PRESS_RIGHT:
-			move(right);
-			break;
-		case KEY_PRESS_UP:
-			move(up);
-			break;
-		case KEY_PRESS_DOWN:
-			move(down);
-			break;
 		case KEY_PRESS_SPACE:
 			createFlame();
 			break;
@@ -154,9 +200,34 @@ void Penelope::doSomething()
 			break;
 		}
 	}
-}
 
+	// Keep walking every tick while a direction key is held down, rather than
+	// waiting for the keyboard's auto-repeat
+	if (!moved && getWorld()->getHeldKey(ch) && directionForKey(ch, d))
+	{
+		move(d);
+	}
+}
 
+bool Penelope::directionForKey(int key, Direction& d)
+{
+	switch (key)
+	{
+	case KEY_PRESS_LEFT:
+		d = left;
+		return true;
+	case KEY_PRESS_RIGHT:
+		d = right;
+		return true;
+	case KEY_PRESS_UP:
+		d = up;
+		return true;
+	case KEY_PRESS_DOWN:
+		d = down;
+		return true;
+	}
+	return false;
+}
 
 void Penelope::createFlame()
 {
@@ -242,6 +313,11 @@ void Penelope::dieByFallOrBurnIfAppropriate()
 	kill();
 }
 
+void Penelope::succumbToInfection()
+{
+	kill();
+}
+
 void Penelope::useExitIfAppropriate()
 {
 	getWorld()->recordLevelFinishedIfAllCitizensGone();
@@ -257,26 +333,6 @@ void Citizen::doSomething()
 {
 	if (!isAlive()) return;
 
-	int timeAlive = getTimeAlive();
-	timeAlive++;
-	setTimeAlive(timeAlive);
-
-	if (isInfected()) incrementInfectionCount();
-
-	// Citizen was just infected
-	if (infectionCount() == 1)
-	{
-		getWorld()->playSound(SOUND_CITIZEN_INFECTED);
-	}
-
-	if (infectionCount() > 500)
-	{
-		turnIntoZombie();
-		return;
-	}
-
-	if (timeAlive % 2 == 0) return;
-
 	// Step 4/5: calculate distance to Penelope/Zombie
 	double closestTriggerX, closestTriggerY, distClosestTrigger ;
 	bool isThreat;
@@ -315,33 +371,13 @@ void Citizen::doSomething()
 		// Check if the nearest zombie is near enough for the citizen to run
 		if (distClosestZombie < 80)
 		{
-			moveAwayFrom(closestZombieX, closestZombieY);
+			moveAwayFromZombies();
 			return;
 		}
 	}
 }
 
 
-// Returns distance to the closest zombie after going 2 pixels in direction d
-// Returns 0 if the citizen cant move in this direction
-double Citizen::checksZombieDistance(Direction d)
-{
-	double nextX, nextY, distClosestZombie;
-	nextX = getX();
-	nextY = getY();
-
-	bool moveSuccess = calculateNextMove(nextX, nextY, 2, d);
-
-	if (!moveSuccess) return 0;
-
-	double zombieX, zombieY;
-	getWorld()->locateNearestCitizenThreat(nextX, nextY,
-		zombieX, zombieY, distClosestZombie);
-
-	return distClosestZombie;
-
-}
-
 // Moves agent towards actor at location x,y
 // Returns true if move is successful
 bool Citizen::moveTowards(double x, double y)
@@ -349,6 +385,9 @@ bool Citizen::moveTowards(double x, double y)
 	Direction d; // Direction (and alternate direction if applicable) to get to to get to Penelope
 	Direction alt_d = -1; // Default as -1 to test if a value is assigned to alt_d
 
+	// Walk the path around walls until sharing a cell with Penelope
+	if (findPathDirection(StudentWorld::NAV_PENELOPE, 2, false, d)) return move(d, 2);
+
 	findDirectionTo(x, y, d, alt_d);
 	// If first move towards direction d is successful
 	if (move(d, 2)) return true;
@@ -359,6 +398,60 @@ bool Citizen::moveTowards(double x, double y)
 	return false;
 }
 
+// Follows the distance field towards (or away from) the nearest target of the given kind
+bool Agent::findPathDirection(int target, double distance, bool away, Direction& d)
+{
+	Direction alt_d = -1;
+	if (!getWorld()->findFieldDirection(static_cast<StudentWorld::NavTarget>(target), getX(), getY(), away, d, alt_d))
+	{
+		return false;
+	}
+
+	if (canMove(d, distance)) return true;
+
+	if (alt_d >= 0 && canMove(alt_d, distance))
+	{
+		d = alt_d;
+		return true;
+	}
+
+	// Straddling two cells can catch the agent on a wall corner, so slide
+	// sideways until lined up with the cell the field points out of
+	Direction align = alignmentDirection(d);
+	if (align >= 0 && canMove(align, distance))
+	{
+		d = align;
+		return true;
+	}
+
+	return false;
+}
+
+bool Agent::canMove(Direction d, double distance)
+{
+	double nextX = getX();
+	double nextY = getY();
+	return calculateNextMove(nextX, nextY, distance, d);
+}
+
+Direction Agent::alignmentDirection(Direction d) const
+{
+	if (d == up || d == down)
+	{
+		double offset = getX() - SPRITE_WIDTH * floor((getX() + SPRITE_WIDTH / 2) / SPRITE_WIDTH);
+		if (offset > 0) return left;
+		if (offset < 0) return right;
+	}
+	else
+	{
+		double offset = getY() - SPRITE_HEIGHT * floor((getY() + SPRITE_HEIGHT / 2) / SPRITE_HEIGHT);
+		if (offset > 0) return down;
+		if (offset < 0) return up;
+	}
+
+	return -1;
+}
+
 void Agent::findDirectionTo(double x, double y, Direction& d, Direction& alt_d)
 {
 	double yDiff, xDiff;
@@ -385,28 +478,14 @@ void Agent::findDirectionTo(double x, double y, Direction& d, Direction& alt_d)
 		alt_d = moveDirArray[abs(1 - mainDir)];
 	}
 }
-// Move away from zombie located at x, y
-void Citizen::moveAwayFrom(double x, double y)
+// Move away from the nearest zombie, following the path it would take
+void Citizen::moveAwayFromZombies()
 {
-	double distanceToZombie = distanceToCenter(x, y);
-
-	Direction dirs[4] = { up, down, left, right };
-	Direction movedir = -1;
-
-	for (int i = 0; i < 4; i++)
+	Direction d;
+	if (findPathDirection(StudentWorld::NAV_ZOMBIES, 2, true, d))
 	{
-		double newDistance = checksZombieDistance(dirs[i]);
-		if (newDistance > distanceToZombie)
-		{
-			distanceToZombie = newDistance;
-			movedir = dirs[i];
-		}
+		move(d, 2);
 	}
-
-	// Distance to zombie has not changed -> do nothing
-	if (distanceToZombie == distanceToCenter(x, y)) return;
-
-	move(movedir, 2);
 }
 
 // Turn citizen into zombie
@@ -425,6 +504,22 @@ void Citizen::turnIntoZombie()
 		getWorld()->addActor(new SmartZombie(getWorld(), getX() / SPRITE_WIDTH, getY() / SPRITE_HEIGHT));
 	}
 }
+void Citizen::beVomitedOnIfAppropriate()
+{
+	// Citizen was just infected
+	if (!isInfected())
+	{
+		getWorld()->playSound(SOUND_CITIZEN_INFECTED);
+	}
+
+	Human::beVomitedOnIfAppropriate();
+}
+
+void Citizen::succumbToInfection()
+{
+	turnIntoZombie();
+}
+
 void Citizen::kill()
 {
 	setDead();
@@ -521,12 +616,6 @@ void DumbZombie::doSomething()
 {
 	if (!isAlive()) return;
 
-	int timeAlive = getTimeAlive();
-	timeAlive++;
-	setTimeAlive(timeAlive);
-
-	if (timeAlive % 2 == 0) return;
-
 	// Attempts to vomit in currently facing direction
 	if (vomit()) return;
 
@@ -557,12 +646,6 @@ void SmartZombie::doSomething()
 {
 	if (!isAlive()) return;
 
-	int timeAlive = getTimeAlive();
-	timeAlive++;
-	setTimeAlive(timeAlive);
-
-	if (timeAlive % 2 == 0) return;
-
 	// Attempts to vomit in currently facing direction
 	if (vomit()) return;
 
@@ -574,12 +657,16 @@ void SmartZombie::doSomething()
 		Direction d = getDirection();
 		Direction alt_d;
 		mvntPlan = randInt(3, 10);
-		bool humanExists = getWorld()->locateNearestVomitTrigger(getX(), getY(), humanX, humanY, distToHuman);
+		bool humanExists = getWorld()->locateNearestOnField(StudentWorld::NAV_HUMANS, getX(), getY(), humanX, humanY, distToHuman);
 		if (humanExists)
 		{
 			if (distToHuman < 80)
 			{
-				findDirectionTo(humanX, humanY, d, alt_d);
+				// Follow the path around walls, or head straight in once in the same cell
+				if (!findPathDirection(StudentWorld::NAV_HUMANS, 1, false, d))
+				{
+					findDirectionTo(humanX, humanY, d, alt_d);
+				}
 				setDirection(d);
 			}
 			else
@@ -670,20 +757,24 @@ void LandmineGoodie::pickUp(Penelope* p)
 // Projectiles //
 /////////////////
 
-void Projectiles::doSomething()
+Projectiles::Projectiles(StudentWorld* world, int imageID, double x, double y, int dir) :
+	Object(world, imageID, x, y, 0, dir)
 {
-	if (isAlive())
-	{
-
-		if (m_timeAlive == 3)
-		{
-			setDead();
-		}
+	// Active on the first tick it acts and the two after, gone on the third.
+	// The old tick counter also called activateOnAppropriateActors on the
+	// tick it died, but activateIfAppropriate does nothing once dead, so
+	// that fourth call never touched anything: three active ticks either way.
+	m_expiryTimer = getWorld()->scheduleTimerAfterSpawn(3, [this]() { setDead(); });
+}
 
-		getWorld()->activateOnAppropriateActors(this);
+Projectiles::~Projectiles()
+{
+	getWorld()->cancelTimer(m_expiryTimer);
+}
 
-		m_timeAlive++;
-	}
+void Projectiles::doSomething()
+{
+	if (isAlive()) getWorld()->activateOnAppropriateActors(this);
 }
 void Flame::activateIfAppropriate(Actor* a)
 {
@@ -735,18 +826,27 @@ void Landmine::explode()
 		}
 	}
 }
-void Landmine::doSomething()
+Landmine::Landmine(StudentWorld* world, double x, double y) :
+	Object(world, IID_LANDMINE, x, y, 1, right)
 {
-	if (!isAlive()) return;
-	if (!m_active)
-	{
-		if (m_safety > 0) m_safety--;
-		else m_active = true;
-	}
-	else if (m_active)
+	// 30 ticks counting down the safety and one more to arm, so the first
+	// check for a trigger comes 31 ticks after the landmine is placed
+	setAsleep(true);
+	m_safetyTimer = getWorld()->scheduleTimer(31, [this]()
 	{
-		getWorld()->activateOnAppropriateActors(this);
-	}
+		m_active = true;
+		setAsleep(false);
+	});
+}
+
+Landmine::~Landmine()
+{
+	getWorld()->cancelTimer(m_safetyTimer);
+}
+
+void Landmine::doSomething()
+{
+	if (isAlive() && m_active) getWorld()->activateOnAppropriateActors(this);
 }
 
 void Pit::activateIfAppropriate(Actor* a)
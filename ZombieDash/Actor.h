@@ -2,6 +2,8 @@
 #define ACTOR_H_
 
 #include "GraphObject.h"
+#include "TimerWheel.h"
+#include "ActorKind.h"
 
 class StudentWorld;
 class Goodies;
@@ -17,12 +19,15 @@ public:
 	// Is the actor alive?
 	bool isAlive() const { return m_isAlive; }
 
-	// Sets the actor to dead
-	void setDead() { m_isAlive = false; }
+	// Sets the actor to dead, to be removed at the end of the tick
+	void setDead();
 
 	// Returns the actor's current world
 	StudentWorld* getWorld() const { return m_world; }
 
+	// What sort of actor this is, for the tick profiler
+	virtual ActorKind kind() const = 0;
+
 	// Modify nextX and nextY with new coords corresponding to a move of distToMove pixels in direction d
 	// Returns false if movement is blocked in direction d
 	bool isActorAt(double x, double y) const ;
@@ -65,6 +70,9 @@ public:
 	// Does this object block flames?
 	virtual bool blocksFlame() const { return false; }
 
+	// Should agents plan their paths around the cell this object occupies?
+	virtual bool blocksPathing() const { return false; }
+
 	// Does this object trigger landmines only when they're active?
 	virtual bool triggersOnlyActiveLandmines() const { return false; }
 
@@ -79,9 +87,32 @@ public:
 
 	virtual void doSomething() = 0;
 
+	// How many ticks pass between calls to doSomething()?  The world spreads
+	// actors with a longer period across phase buckets as they are added.
+	virtual int updatePeriod() const { return 1; }
+
+	// Record this actor's place in the order the world updates actors in
+	void setUpdateOrder(long order) { m_updateOrder = order; }
+	long updateOrder() const { return m_updateOrder; }
+
+	// A sleeping actor is skipped by the tick loop until something (usually a
+	// timer) wakes it, though other actors can still act on it
+	void setAsleep(bool asleep) { m_asleep = asleep; }
+	bool isAsleep() const { return m_asleep; }
+
+#ifdef ZD_TRACK_ALLOCATIONS
+	// Actors keep their allocated size just in front of them, so the
+	// allocation report can total the bytes held by each kind of actor
+	static void* operator new(std::size_t size);
+	static void operator delete(void* p);
+	static std::size_t allocatedSize(const Actor* a);
+#endif
+
 private:
 	StudentWorld* m_world;
 	bool m_isAlive = true;
+	bool m_asleep = false;
+	long m_updateOrder = 0;
 };
 
 class Agent : public Actor
@@ -97,11 +128,6 @@ public:
 	// Agents only triggers active landmines
 	virtual bool triggersOnlyActiveLandmines() const { return true; }
 
-	// Agents need to keep track of their time alive because some of them (citizens and zombies)
-	// paralyzes every second tick
-	int getTimeAlive() { return m_timeAlive; }
-	void setTimeAlive(int time) { m_timeAlive = time; }
-
 	// Attempts to move agent in the direction d for distance distance
 	// Returns true if movement is successful
 	bool move(Direction d, double distance);
@@ -110,11 +136,23 @@ public:
 	// the agent closer to x, y
 	void findDirectionTo(double x, double y, Direction& d, Direction& alt_d);
 
+	// Modifies d to be a direction that follows the world's distance field for target
+	// around walls (away from the target if away is true) in which the agent can take
+	// a step of distance
+	// Returns false if the field has no step to offer (e.g. target is in the same cell)
+	// or none of its steps can be taken
+	bool findPathDirection(int target, double distance, bool away, Direction& d);
+
 	// Modify nextX and nextY with new coords corresponding to a move of distToMove pixels in direction d
 	// Returns false if movement is blocked in direction d
 	bool calculateNextMove(double& nextX, double& nextY, double distToMove, Direction d);
 private:
-	int m_timeAlive = 0;
+	// Returns true if a move of distance pixels in direction d is not blocked
+	bool canMove(Direction d, double distance);
+
+	// Returns the direction perpendicular to d that lines the agent up with its
+	// current grid cell, or -1 if it is already lined up
+	Direction alignmentDirection(Direction d) const;
 };
 
 // Humans base class for the player character and citizens
@@ -124,6 +162,7 @@ public:
 	Human(StudentWorld* world, int imageID, double x, double y) :
 		Agent(world, imageID, x, y)
 	{}
+	virtual ~Human();
 
 	// Humans can be infected by vomit
 	virtual bool triggersZombieVomit() const { return true; }
@@ -132,12 +171,17 @@ public:
 	// Clears current infection count and set status to not infected
 	void clearInfection();
 
-	void incrementInfectionCount() { m_infectionCount++; }
 	bool isInfected() const { return m_isInfected; }
-	int infectionCount() const { return m_infectionCount; }
+
+	// Number of ticks since this human was infected
+	int infectionCount() const;
 private:
+	// Called by the infection timer once the infection has run its course
+	virtual void succumbToInfection() = 0;
+
 	bool m_isInfected = false;
-	int m_infectionCount = 0;
+	int m_infectedTick = 0; // tick on which the infection started
+	TimerWheel::TimerID m_infectionTimer = TimerWheel::NO_TIMER;
 };
 
 // Player character
@@ -149,6 +193,7 @@ public:
 		Human(world, IID_PLAYER, x, y)
 	{}
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_PENELOPE; }
 	virtual void useExitIfAppropriate();
 	virtual void dieByFallOrBurnIfAppropriate();
 	virtual void pickUpGoodieIfAppropriate(Goodies* g);
@@ -177,9 +222,15 @@ private:
 	// Penelope specfic kill command to play sound when player die
 	void kill();
 
+	// Penelope dies when her infection runs out
+	virtual void succumbToInfection();
+
 	// Attempts to move in direction d
 	void move(Direction d);
 
+	// Sets d to the direction a movement key stands for; false for other keys
+	static bool directionForKey(int key, Direction& d);
+
 	// Creates 3 flames 3 spaces ahead of Penelope if not blocked
 	void createFlame();
 
@@ -201,22 +252,26 @@ public:
 		Human(world, IID_CITIZEN, x, y)
 	{}
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_CITIZEN; }
 	virtual void useExitIfAppropriate();
 	virtual void dieByFallOrBurnIfAppropriate();
+	virtual void beVomitedOnIfAppropriate();
+
+	// Citizens are paralyzed every second tick, starting with the tick after they appear
+	virtual int updatePeriod() const { return 2; }
 private:
 	// Kill this citizen and turn them into zombie
 	void turnIntoZombie();
 
+	// Citizens turn into zombies when their infection runs out
+	virtual void succumbToInfection();
+
 	// Attempts to move towards x,y
 	// Returns true if move is successful
 	bool moveTowards(double x, double y);
 
-	// Attempts to move away from x,y
-	void moveAwayFrom(double x, double y);
-
-	// Returns the closest zombie distance if a move was to be made in
-	// direction d
-	double checksZombieDistance(Direction d);
+	// Attempts to move further from the nearest zombie by path
+	void moveAwayFromZombies();
 
 	// Kill function specific to citizens to play sound
 	void kill();
@@ -238,6 +293,9 @@ public:
 	virtual bool triggersCitizens() const { return true; }
 	virtual bool threatensCitizens() const { return true; }
 
+	// Zombies are paralyzed every second tick, starting with the tick after they appear
+	virtual int updatePeriod() const { return 2; }
+
 	// All zombies have a set movement plan
 	int getMvntPlanDist() { return m_mvntPlanDist; }
 	void setMvntPlanDist(int plan) { m_mvntPlanDist = plan; }
@@ -257,6 +315,7 @@ public:
 		Zombie(world, x, y)
 	{}
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_DUMB_ZOMBIE; }
 	virtual void dieByFallOrBurnIfAppropriate();
 private:
 	// Attempts to fling vaccine in direction d
@@ -270,6 +329,7 @@ public:
 		Zombie(world, x, y)
 	{}
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_SMART_ZOMBIE; }
 	virtual void dieByFallOrBurnIfAppropriate();
 
 };
@@ -294,6 +354,7 @@ public:
 	virtual void activateIfAppropriate(Actor* a);
 	virtual void dieByFallOrBurnIfAppropriate();
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_GOODIE; }
 	// Have p pick up this goodie.
 	virtual void pickUp(Penelope* p) = 0;
 };
@@ -332,12 +393,12 @@ public:
 class Projectiles : public Object
 {
 public:
-	Projectiles(StudentWorld* world, int imageID, double x, double y, int dir) :
-		Object(world, imageID, x, y, 0, dir)
-	{}
+	Projectiles(StudentWorld* world, int imageID, double x, double y, int dir);
+	virtual ~Projectiles();
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_PROJECTILE; }
 private:
-	int m_timeAlive = 0; // Counts up to 2 ticks
+	TimerWheel::TimerID m_expiryTimer; // Disappears 3 ticks after creation
 };
 
 // Projectile classes go here
@@ -362,17 +423,17 @@ public:
 class Landmine : public Object
 {
 public:
-	Landmine(StudentWorld* world, double x, double y) :
-		Object(world, IID_LANDMINE, x, y, 1, right)
-	{}
+	Landmine(StudentWorld* world, double x, double y);
+	virtual ~Landmine();
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_LANDMINE; }
 	virtual void activateIfAppropriate(Actor* a);
 	virtual void dieByFallOrBurnIfAppropriate();
 private:
 	// Make the landmine explode, introducing a pit in its current location and flames in 8 squares surrounding 
 	// the pit
 	void explode();
-	int m_safety = 30;
+	TimerWheel::TimerID m_safetyTimer; // Sleeps through 30 safety ticks, then arms itself
 	bool m_active = false;
 };
 
@@ -383,9 +444,15 @@ class Pit : public Object
 public:
 	Pit(StudentWorld* world, double x, double y) :
 		Object(world, IID_PIT, x, y, 0, right)
-	{}
+	{
+		setStatic();
+	}
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_PIT; }
 	virtual void activateIfAppropriate(Actor* a);
+
+	// Agents route around pits rather than through them
+	virtual bool blocksPathing() const { return true; }
 };
 
 class Exit : public Object
@@ -393,8 +460,11 @@ class Exit : public Object
 public:
 	Exit(StudentWorld* world, double x, double y) :
 		Object(world, IID_EXIT, x, y, 1, right)
-	{}
+	{
+		setStatic();
+	}
 	virtual void doSomething();
+	virtual ActorKind kind() const { return KIND_EXIT; }
 	virtual void activateIfAppropriate(Actor* a);
 	virtual bool blocksFlame() const { return true; }
 };
@@ -404,12 +474,16 @@ class Wall : public Actor
 public:
 	Wall(StudentWorld* world, double x, double y) :
 		Actor(world, IID_WALL, x, y)
-	{}
+	{
+		setStatic();
+	}
 	virtual void doSomething() {};
+	virtual ActorKind kind() const { return KIND_WALL; }
 
-	// Wall blocks movement and flame
+	// Wall blocks movement, flame and path planning
 	virtual bool blocksMovement() const {return true;}
 	virtual bool blocksFlame() const { return true; }
+	virtual bool blocksPathing() const { return true; }
 };
 
 
@@ -0,0 +1,30 @@
+#ifndef ACTORKIND_H_
+#define ACTORKIND_H_
+
+// Coarse categories of actor, used to attribute tick time and memory in the
+// profiler and allocation report
+enum ActorKind
+{
+	KIND_PENELOPE,
+	KIND_CITIZEN,
+	KIND_DUMB_ZOMBIE,
+	KIND_SMART_ZOMBIE,
+	KIND_GOODIE,
+	KIND_PROJECTILE,
+	KIND_LANDMINE,
+	KIND_PIT,
+	KIND_EXIT,
+	KIND_WALL,
+	NUM_ACTOR_KINDS
+};
+
+inline const char* actorKindName(int kind)
+{
+	static const char* const names[NUM_ACTOR_KINDS] = {
+		"Penelope", "Citizen", "DumbZombie", "SmartZombie", "Goodies", "Projectiles",
+		"Landmine", "Pit", "Exit", "Wall"
+	};
+	return names[kind];
+}
+
+#endif // ACTORKIND_H_
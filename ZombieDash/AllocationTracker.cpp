@@ -0,0 +1,255 @@
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+using namespace std;
+
+namespace
+{
+      // Zero before any constructor runs, so allocations made during static
+      // initialization are counted too
+    atomic<unsigned long>       g_allocations[AllocationTracker::NUM_PHASES];
+    atomic<unsigned long long>  g_bytes[AllocationTracker::NUM_PHASES];
+
+    const char* const PHASE_NAMES[AllocationTracker::NUM_PHASES] = {
+        "other", "level load", "timers", "navigation", "actor update",
+        "spawn", "layer insert", "commit", "stat text"
+    };
+}
+
+void AllocationTracker::Counts::clear()
+{
+    for (int p = 0; p < NUM_PHASES; p++)
+    {
+        allocations[p] = 0;
+        bytes[p] = 0;
+    }
+}
+
+unsigned long AllocationTracker::Counts::totalAllocations() const
+{
+    unsigned long total = 0;
+    for (int p = 0; p < NUM_PHASES; p++)
+        total += allocations[p];
+    return total;
+}
+
+void AllocationTracker::recordAllocation(size_t bytes)
+{
+    Phase phase = currentPhase();
+    g_allocations[phase].fetch_add(1, memory_order_relaxed);
+    g_bytes[phase].fetch_add(bytes, memory_order_relaxed);
+}
+
+void AllocationTracker::read(Counts& counts)
+{
+    for (int p = 0; p < NUM_PHASES; p++)
+    {
+        counts.allocations[p] = g_allocations[p].load(memory_order_relaxed);
+        counts.bytes[p] = g_bytes[p].load(memory_order_relaxed);
+    }
+}
+
+const char* AllocationTracker::phaseName(int phase)
+{
+    return PHASE_NAMES[phase];
+}
+
+void TickAllocations::reset()
+{
+    m_atTickStart.clear();
+    m_lastTick.clear();
+    m_total.clear();
+    m_ticks = 0;
+    m_allocatingTicks = 0;
+    m_mostInOneTick = 0;
+}
+
+void TickAllocations::beginTick()
+{
+    AllocationTracker::read(m_atTickStart);
+}
+
+void TickAllocations::endTick()
+{
+    AllocationTracker::Counts now;
+    AllocationTracker::read(now);
+    for (int p = 0; p < AllocationTracker::NUM_PHASES; p++)
+    {
+        m_lastTick.allocations[p] = now.allocations[p] - m_atTickStart.allocations[p];
+        m_lastTick.bytes[p] = now.bytes[p] - m_atTickStart.bytes[p];
+        m_total.allocations[p] += m_lastTick.allocations[p];
+        m_total.bytes[p] += m_lastTick.bytes[p];
+    }
+
+    unsigned long allocations = m_lastTick.totalAllocations();
+    m_ticks++;
+    if (allocations > 0)
+        m_allocatingTicks++;
+    m_mostInOneTick = max(m_mostInOneTick, allocations);
+}
+
+void TickAllocations::report(ostream& os, int level) const
+{
+    os << "Allocations for level " << level << " over " << m_ticks << " ticks: "
+       << m_total.totalAllocations() << " in " << m_allocatingTicks
+       << " ticks, at most " << m_mostInOneTick << " in one tick" << endl;
+    for (int p = 0; p < AllocationTracker::NUM_PHASES; p++)
+    {
+        if (m_total.allocations[p] == 0)
+            continue;
+        os << "  " << left << setw(14) << AllocationTracker::phaseName(p) << right
+           << setw(9) << m_total.allocations[p] << " allocations"
+           << setw(11) << m_total.bytes[p] << " bytes" << endl;
+    }
+}
+
+#ifdef ZD_TRACK_ALLOCATIONS
+
+  // Every replaceable global form of new and delete is replaced.  Whether
+  // the default nothrow and aligned forms call the plain ones depends on
+  // the library, and a sanitizer brings its own, so any form left out
+  // could go uncounted and be freed by a delete it wasn't paired with.
+  // stable_sort's temporary buffer, for one, uses nothrow new.
+namespace
+{
+    void* allocate(size_t size)
+    {
+        AllocationTracker::recordAllocation(size);
+        return malloc(size == 0 ? 1 : size);
+    }
+
+    void* allocateAligned(size_t size, align_val_t alignment)
+    {
+        AllocationTracker::recordAllocation(size);
+        size_t align = static_cast<size_t>(alignment);
+          // aligned_alloc wants a whole number of alignments
+        size_t rounded = (size == 0 ? align : (size + align - 1) / align * align);
+#ifdef _MSC_VER
+        return _aligned_malloc(rounded, align);
+#else
+        return aligned_alloc(align, rounded);
+#endif
+    }
+
+    void freeAligned(void* p)
+    {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+}
+
+void* operator new(size_t size)
+{
+    void* p = allocate(size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept
+{
+    free(p);
+}
+
+  // Over-aligned types, such as the buffers of containers of them
+
+void* operator new(size_t size, align_val_t alignment)
+{
+    void* p = allocateAligned(size, alignment);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size, align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* p, align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+void operator delete[](void* p, align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+void operator delete(void* p, size_t, align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+void operator delete[](void* p, size_t, align_val_t) noexcept
+{
+    freeAligned(p);
+}
+
+void operator delete(void* p, align_val_t, const nothrow_t&) noexcept
+{
+    freeAligned(p);
+}
+
+void operator delete[](void* p, align_val_t, const nothrow_t&) noexcept
+{
+    freeAligned(p);
+}
+
+#endif // ZD_TRACK_ALLOCATIONS
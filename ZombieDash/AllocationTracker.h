@@ -0,0 +1,158 @@
+#ifndef ALLOCATIONTRACKER_H_
+#define ALLOCATIONTRACKER_H_
+
+#include <cstddef>
+#include <ostream>
+
+  // Counts heap allocations, and the bytes asked for, by the phase of the
+  // game that made them.  When ZD_TRACK_ALLOCATIONS is defined, the global
+  // operator new is replaced to do the counting, so string and container
+  // growth is caught as well as actors; otherwise nothing is counted and
+  // ALLOCATION_PHASE and ALLOCATION_TICK expand to nothing.
+class AllocationTracker
+{
+  public:
+
+    enum Phase
+    {
+        PHASE_OTHER,            // outside all the phases below
+        PHASE_LEVEL_LOAD,
+        PHASE_TIMERS,
+        PHASE_NAVIGATION,
+        PHASE_ACTOR_UPDATE,     // doSomething(), apart from the phases it enters
+        PHASE_SPAWN,            // allocating actors and handing them to the world
+        PHASE_LAYER_INSERT,     // GraphObject adding itself to a drawing layer
+        PHASE_COMMIT,           // applying a tick's spawns and deaths to the actor list
+        PHASE_STAT_TEXT,
+        NUM_PHASES
+    };
+
+    struct Counts
+    {
+        unsigned long       allocations[NUM_PHASES];
+        unsigned long long  bytes[NUM_PHASES];
+
+        void clear();
+        unsigned long totalAllocations() const;
+    };
+
+      // Called by operator new on every allocation
+    static void recordAllocation(std::size_t bytes);
+
+      // Everything counted since the program started
+    static void read(Counts& counts);
+
+    static const char* phaseName(int phase);
+
+      // Makes phase the current thread's phase until it is destroyed
+    class Scope
+    {
+      public:
+
+        explicit Scope(Phase phase)
+         : m_previous(currentPhase())
+        {
+            currentPhase() = phase;
+        }
+
+        ~Scope()
+        {
+            currentPhase() = m_previous;
+        }
+
+          // Prevent copying or assigning Scopes
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+
+        Phase   m_previous;
+    };
+
+  private:
+
+    static Phase& currentPhase()
+    {
+        thread_local Phase phase = PHASE_OTHER;
+        return phase;
+    }
+};
+
+  // Allocations made during each of a series of ticks, such as those of one
+  // level, so that a tick that allocates at all stands out
+class TickAllocations
+{
+  public:
+
+    TickAllocations() { reset(); }
+
+      // Forget everything recorded so far
+    void reset();
+
+    void beginTick();
+    void endTick();
+
+      // The most recently finished tick
+    const AllocationTracker::Counts& lastTick() const
+    {
+        return m_lastTick;
+    }
+
+      // All ticks since the last reset
+    const AllocationTracker::Counts& total() const
+    {
+        return m_total;
+    }
+
+      // Write a table of the allocations made in each phase since the last reset
+    void report(std::ostream& os, int level) const;
+
+      // Counts the allocations made from its construction to its destruction
+      // as one tick
+    class TickScope
+    {
+      public:
+
+        explicit TickScope(TickAllocations& ticks)
+         : m_ticks(ticks)
+        {
+            m_ticks.beginTick();
+        }
+
+        ~TickScope()
+        {
+            m_ticks.endTick();
+        }
+
+          // Prevent copying or assigning TickScopes
+        TickScope(const TickScope&) = delete;
+        TickScope& operator=(const TickScope&) = delete;
+
+      private:
+
+        TickAllocations&    m_ticks;
+    };
+
+  private:
+
+    AllocationTracker::Counts   m_atTickStart;
+    AllocationTracker::Counts   m_lastTick;
+    AllocationTracker::Counts   m_total;
+    int             m_ticks;
+    int             m_allocatingTicks;      // ticks that allocated anything
+    unsigned long   m_mostInOneTick;
+};
+
+#ifdef ZD_TRACK_ALLOCATIONS
+#define ALLOCATION_CONCAT_(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_(a, b)
+#define ALLOCATION_PHASE(phase) \
+    AllocationTracker::Scope ALLOCATION_CONCAT(allocationPhase, __LINE__)(AllocationTracker::phase)
+#define ALLOCATION_TICK(ticks) \
+    TickAllocations::TickScope ALLOCATION_CONCAT(allocationTick, __LINE__)(ticks)
+#else
+#define ALLOCATION_PHASE(phase) ((void)0)
+#define ALLOCATION_TICK(ticks) ((void)0)
+#endif
+
+#endif // ALLOCATIONTRACKER_H_
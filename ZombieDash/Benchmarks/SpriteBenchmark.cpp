@@ -0,0 +1,266 @@
+  // Times building and drawing a frame of 10,000 sprites with SpriteManager's
+  // flat lookup tables against the std::map lookup they replaced.  The map
+  // path is rebuilt here from the same atlas regions, and both feed the same
+  // vertex code, so the lookup is the only difference; the two vertex arrays
+  // are compared to make sure of it.
+  //
+  // It draws offscreen through EGL, so it needs no window.  It is a program
+  // of its own rather than part of the game project.  On Linux, from this
+  // directory:
+  //
+  //   g++ -std=c++17 -O2 -I.. -o SpriteBenchmark SpriteBenchmark.cpp -lEGL -lGL -lGLU
+  //   ./SpriteBenchmark ../Assets
+  //
+  // With no display server, run it with EGL_PLATFORM=surfaceless set.
+
+#include <EGL/egl.h>
+#include "SpriteManager.h"
+#include <GL/glu.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+static const int NUM_SPRITES = 10000;
+static const int ROUNDS = 15;
+static const int BUILDS_PER_ROUND = 50;
+static const int DRAWS_PER_ROUND = 2;
+static const int SURFACE_SIZE = 768;
+
+struct SpritePlot
+{
+    int     imageID;
+    int     frame;
+    double  x;
+    double  y;
+    int     angle;
+};
+
+class SpriteBenchmark
+{
+  public:
+
+    SpriteBenchmark(SpriteManager& sprites)
+     : m_sprites(sprites)
+    {
+          // The tables the old SpriteManager kept, keyed by getSpriteID
+        for (int imageID = 0; imageID < sprites.m_numImages; imageID++)
+        {
+            for (int frame = 0; frame < sprites.m_framesPerImage; frame++)
+            {
+                const SpriteManager::AtlasRegion& region = sprites.m_regions[imageID * sprites.m_framesPerImage + frame];
+                if (region.loaded)
+                    m_imageMap[SpriteManager::getSpriteID(imageID, frame)] = region;
+            }
+        }
+    }
+
+      // SpriteManager::plotSprite as it was before the flat tables
+    bool plotSpriteWithMap(int imageID, int frame, double x, double y, int angleDegrees, double size)
+    {
+        int spriteID = SpriteManager::getSpriteID(imageID, frame);
+        if (spriteID == SpriteManager::INVALID_SPRITE_ID)
+            return false;
+
+        auto it = m_imageMap.find(spriteID);
+        if (it == m_imageMap.end())
+            return false;
+
+        const SpriteManager::AtlasRegion& region = it->second;
+        vector<SpriteManager::BatchVertex>& out = m_sprites.m_vertices;
+        out.resize(out.size() + 4);
+        SpriteManager::BatchVertex* vertices = &out[out.size() - 4];
+
+        double halfWidth = SPRITE_WIDTH_GL * size / 2;
+        double halfHeight = SPRITE_HEIGHT_GL * size / 2;
+
+        double gx, gy, gz;
+        SpriteManager::convertToGlutCoords(x, y, gx, gy, gz);
+
+        const GLfloat texCoords[4][2] = {
+            { region.u0, region.v0 }, { region.u1, region.v0 }, { region.u1, region.v1 }, { region.u0, region.v1 }
+        };
+        double corners[4][2];
+        SpriteManager::orientedCorners(angleDegrees, halfWidth, halfHeight, corners);
+        for (int k = 0; k < 4; k++)
+        {
+            vertices[k].x = static_cast<GLfloat>(gx + corners[k][0]);
+            vertices[k].y = static_cast<GLfloat>(gy + corners[k][1]);
+            vertices[k].z = static_cast<GLfloat>(gz);
+            vertices[k].u = texCoords[k][0];
+            vertices[k].v = texCoords[k][1];
+        }
+
+        return true;
+    }
+
+    void buildWithMap(const vector<SpritePlot>& scene)
+    {
+        m_sprites.beginBatch();
+        for (const SpritePlot& p : scene)
+            plotSpriteWithMap(p.imageID, p.frame, p.x, p.y, p.angle, 1.0);
+    }
+
+    void buildWithArrays(const vector<SpritePlot>& scene)
+    {
+        m_sprites.beginBatch();
+        for (const SpritePlot& p : scene)
+            m_sprites.plotSprite(p.imageID, p.frame, p.x, p.y, p.angle, 1.0);
+    }
+
+      // Do the two lookups build exactly the same vertex array for scene?
+    bool buildsMatch(const vector<SpritePlot>& scene)
+    {
+        buildWithMap(scene);
+        vector<SpriteManager::BatchVertex> mapVertices = m_sprites.m_vertices;
+        buildWithArrays(scene);
+        const vector<SpriteManager::BatchVertex>& arrayVertices = m_sprites.m_vertices;
+        return mapVertices.size() == arrayVertices.size()  &&
+               memcmp(mapVertices.data(), arrayVertices.data(), mapVertices.size() * sizeof(mapVertices[0])) == 0;
+    }
+
+  private:
+
+    SpriteManager&                              m_sprites;
+    map<int, SpriteManager::AtlasRegion>        m_imageMap;
+};
+
+static bool openOffscreenContext()
+{
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY  ||  !eglInitialize(display, &major, &minor))
+        return false;
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 16, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &numConfigs)  ||  numConfigs == 0)
+        return false;
+
+    const EGLint surfaceAttributes[] = { EGL_WIDTH, SURFACE_SIZE, EGL_HEIGHT, SURFACE_SIZE, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    eglBindAPI(EGL_OPENGL_API);
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    return surface != EGL_NO_SURFACE  &&  context != EGL_NO_CONTEXT  &&
+           eglMakeCurrent(display, surface, surface, context);
+}
+
+  // The projection GameController sets up, so drawing costs what it does in
+  // the game
+static void beginFrame()
+{
+    glViewport(0, 0, SURFACE_SIZE, SURFACE_SIZE);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(45.0, 1.0, 4, 22);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gluLookAt(0, 0, 0, 0, 0, -1, 0, 1, 0);
+}
+
+  // Median over ROUNDS of the mean milliseconds per frame in each round
+template <typename Frame>
+static double timeFrames(int framesPerRound, Frame frame)
+{
+    vector<double> rounds;
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        auto start = chrono::steady_clock::now();
+        for (int f = 0; f < framesPerRound; f++)
+            frame();
+        rounds.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / framesPerRound);
+    }
+    sort(rounds.begin(), rounds.end());
+    return rounds[ROUNDS / 2];
+}
+
+int main(int argc, char* argv[])
+{
+    string assetPath = (argc > 1 ? argv[1] : "../Assets");
+    if (assetPath.back() != '/')
+        assetPath += '/';
+
+    if (!openOffscreenContext())
+    {
+        fprintf(stderr, "Cannot open an offscreen OpenGL context\n");
+        return 1;
+    }
+
+    static const struct { int imageID; int frame; const char* file; } spriteFiles[] = {
+        { IID_PLAYER         , 0, "girl1.tga" },
+        { IID_PLAYER         , 1, "girl2.tga" },
+        { IID_PLAYER         , 2, "girl3.tga" },
+        { IID_ZOMBIE         , 0, "zombie1.tga" },
+        { IID_ZOMBIE         , 1, "zombie2.tga" },
+        { IID_ZOMBIE         , 2, "zombie3.tga" },
+        { IID_CITIZEN        , 0, "dude1.tga" },
+        { IID_CITIZEN        , 1, "dude2.tga" },
+        { IID_CITIZEN        , 2, "dude3.tga" },
+        { IID_VOMIT          , 0, "vomit.tga" },
+        { IID_PIT            , 0, "pit.tga" },
+        { IID_LANDMINE       , 0, "mine.tga" },
+        { IID_VACCINE_GOODIE , 0, "health.tga" },
+        { IID_GAS_CAN_GOODIE , 0, "gascan.tga" },
+        { IID_LANDMINE_GOODIE, 0, "ammo.tga" },
+        { IID_EXIT           , 0, "exit.tga" },
+        { IID_WALL           , 0, "wall.tga" },
+    };
+
+    SpriteManager sprites;
+    vector<pair<int, int>> loaded;
+    for (const auto& s : spriteFiles)
+    {
+        if (sprites.loadSprite(assetPath + s.file, s.imageID, s.frame))
+            loaded.push_back(make_pair(s.imageID, s.frame));
+    }
+    if (loaded.empty()  ||  !sprites.buildAtlas())
+    {
+        fprintf(stderr, "Cannot load the sprites from %s\n", assetPath.c_str());
+        return 1;
+    }
+
+      // The same scene every run: random loaded frames facing the four
+      // directions the game uses, anywhere in view
+    mt19937 random(3);
+    vector<SpritePlot> scene;
+    for (int i = 0; i < NUM_SPRITES; i++)
+    {
+        const pair<int, int>& sprite = loaded[random() % loaded.size()];
+        scene.push_back(SpritePlot{ sprite.first, sprite.second,
+                                    static_cast<double>(random() % VIEW_WIDTH),
+                                    static_cast<double>(random() % VIEW_HEIGHT),
+                                    static_cast<int>(random() % 4) * 90 });
+    }
+
+    SpriteBenchmark bench(sprites);
+    if (!bench.buildsMatch(scene))
+    {
+        fprintf(stderr, "The two lookups built different vertex arrays\n");
+        return 1;
+    }
+
+    printf("%d sprites, %d frames loaded, renderer %s\n", NUM_SPRITES, static_cast<int>(loaded.size()),
+           reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    printf("                    std::map    arrays   (median ms per frame)\n");
+
+    double buildMap = timeFrames(BUILDS_PER_ROUND, [&] { bench.buildWithMap(scene); });
+    double buildArrays = timeFrames(BUILDS_PER_ROUND, [&] { bench.buildWithArrays(scene); });
+    printf("  build draw list   %8.3f  %8.3f\n", buildMap, buildArrays);
+    fflush(stdout);
+
+      // With a software renderer each draw takes a while, so fewer of them
+    double drawMap = timeFrames(DRAWS_PER_ROUND, [&] { beginFrame(); bench.buildWithMap(scene); sprites.flushBatch(); glFinish(); });
+    double drawArrays = timeFrames(DRAWS_PER_ROUND, [&] { beginFrame(); bench.buildWithArrays(scene); sprites.flushBatch(); glFinish(); });
+    printf("  build and draw    %8.3f  %8.3f\n", drawMap, drawArrays);
+    return 0;
+}
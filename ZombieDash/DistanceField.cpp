@@ -0,0 +1,63 @@
+#include "DistanceField.h"
+
+void DistanceField::clear()
+{
+	for (int row = 0; row < LEVEL_HEIGHT; row++)
+	{
+		for (int col = 0; col < LEVEL_WIDTH; col++)
+		{
+			m_distance[row][col] = UNREACHABLE;
+			m_source[row][col] = nullptr;
+		}
+	}
+	m_queueLength = 0;
+}
+
+void DistanceField::addSource(int col, int row, const Actor* source)
+{
+	if (col < 0 || col >= LEVEL_WIDTH || row < 0 || row >= LEVEL_HEIGHT) return;
+
+	// Several sources may share a cell, the first one seeded keeps it
+	if (m_distance[row][col] != UNREACHABLE) return;
+
+	m_distance[row][col] = 0;
+	m_source[row][col] = source;
+	m_queue[m_queueLength++] = row * LEVEL_WIDTH + col;
+}
+
+void DistanceField::propagate(const bool walkable[LEVEL_HEIGHT][LEVEL_WIDTH])
+{
+	static const int colSteps[4] = { 1, -1, 0, 0 };
+	static const int rowSteps[4] = { 0, 0, 1, -1 };
+
+	// Every cell enters the queue at most once, so the queue array never overflows
+	for (int head = 0; head < m_queueLength; head++)
+	{
+		int row = m_queue[head] / LEVEL_WIDTH;
+		int col = m_queue[head] % LEVEL_WIDTH;
+
+		for (int i = 0; i < 4; i++)
+		{
+			int nextCol = col + colSteps[i];
+			int nextRow = row + rowSteps[i];
+			if (nextCol < 0 || nextCol >= LEVEL_WIDTH || nextRow < 0 || nextRow >= LEVEL_HEIGHT) continue;
+			if (!walkable[nextRow][nextCol] || m_distance[nextRow][nextCol] != UNREACHABLE) continue;
+
+			m_distance[nextRow][nextCol] = m_distance[row][col] + 1;
+			m_source[nextRow][nextCol] = m_source[row][col];
+			m_queue[m_queueLength++] = nextRow * LEVEL_WIDTH + nextCol;
+		}
+	}
+}
+
+int DistanceField::distanceAt(int col, int row) const
+{
+	if (col < 0 || col >= LEVEL_WIDTH || row < 0 || row >= LEVEL_HEIGHT) return UNREACHABLE;
+	return m_distance[row][col];
+}
+
+const Actor* DistanceField::nearestSourceAt(int col, int row) const
+{
+	if (col < 0 || col >= LEVEL_WIDTH || row < 0 || row >= LEVEL_HEIGHT) return nullptr;
+	return m_source[row][col];
+}
@@ -0,0 +1,40 @@
+#ifndef DISTANCEFIELD_H_
+#define DISTANCEFIELD_H_
+
+#include "GameConstants.h"
+
+class Actor;
+
+// Multi-source breadth-first distance over the level grid.  Every walkable
+// cell records how many steps it is from the nearest source and which source
+// that was, so agents can read a wall-aware gradient in constant time.
+class DistanceField
+{
+public:
+	static const int UNREACHABLE = -1;
+
+	DistanceField() { clear(); }
+
+	// Forget all sources and distances
+	void clear();
+
+	// Seed the field with a source actor standing in cell col, row
+	void addSource(int col, int row, const Actor* source);
+
+	// Flood outwards from every source through the walkable cells
+	void propagate(const bool walkable[LEVEL_HEIGHT][LEVEL_WIDTH]);
+
+	// Steps from col, row to the nearest source, or UNREACHABLE
+	int distanceAt(int col, int row) const;
+
+	// The source nearest to col, row by path, or nullptr if none is reachable
+	const Actor* nearestSourceAt(int col, int row) const;
+
+private:
+	int m_distance[LEVEL_HEIGHT][LEVEL_WIDTH];
+	const Actor* m_source[LEVEL_HEIGHT][LEVEL_WIDTH];
+	int m_queue[LEVEL_WIDTH * LEVEL_HEIGHT]; // cells in BFS order, packed as row * LEVEL_WIDTH + col
+	int m_queueLength;
+};
+
+#endif // DISTANCEFIELD_H_
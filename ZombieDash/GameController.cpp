@@ -5,11 +5,18 @@
 #include "GraphObject.h"
 #include "SoundFX.h"
 #include "SpriteManager.h"
+#include "Trace.h"
+#include "AllocationTracker.h"
+#include "Metrics.h"
+#include "Log.h"
 #include <string>
 #include <map>
 #include <utility>
 #include <cstdlib>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 using namespace std;
 
 /*
@@ -43,6 +50,20 @@ static const double SCORE_Z = -10;
 
 static const int MS_PER_FRAME = 5;
 
+  // The simulation runs at a fixed rate however fast frames are drawn.  If
+  // drawing falls behind, up to MAX_TICKS_PER_UPDATE ticks are run before the
+  // next frame, and any further backlog is dropped.
+static const int DEFAULT_TICKS_PER_SECOND = 30;
+static const int MAX_TICKS_PER_UPDATE = 5;
+
+  // In turbo mode, each frame runs a fixed number of ticks if one was given
+  // on the command line, otherwise as many as fit in this many milliseconds
+static const double TURBO_FRAME_BUDGET_MS = 15;
+
+  // Published metrics are brought up to date at most this often
+static const double METRICS_UPDATE_MS = 1000;
+static const double TICK_QUANTILES[] = { .5, .9, .99 };
+
 struct SpriteInfo
 {
     int         imageID;
@@ -50,14 +71,23 @@ struct SpriteInfo
     std::string tgaFileName;
 };
 
-static void drawPrompt(string mainMessage, string secondMessage);
-static void drawScoreAndLives(string);
+static void outputStroke(double x, double y, double z, double size, const char* str);
+static void drawPrompt(const string& mainMessage, const string& secondMessage);
+static void strokeScoreAndLives(const string& gameStatText);
+static void drawScoreAndLives(GLuint hudList);
 
 enum GameController::GameControllerState : int {
     welcome, init, makemove, animate, contgame, finishedlevel, cleanup,
     gameover, prompt, quit, not_applicable
 };
 
+  // Trace event names, in the order above
+static const char* const STATE_TRACE_NAMES[] = {
+    "state welcome", "state init", "state makemove", "state animate",
+    "state contgame", "state finishedlevel", "state cleanup", "state gameover",
+    "state prompt", "state quit", "state not_applicable"
+};
+
 void GameController::initDrawersAndSounds()
 {
     SpriteInfo drawers[] = {
@@ -102,13 +132,15 @@ void GameController::initDrawersAndSounds()
         if (!m_spriteManager.loadSprite(path + d.tgaFileName, d.imageID, d.frameNum))
             exit(1);
     }
+    if (!m_spriteManager.buildAtlas())
+        exit(1);
     for (const auto& s : sounds)
         m_soundMap[s.first] = s.second;
 }
 
-static void doSomethingCallback()
+static void displayCallback()
 {
-    Game().doSomething();
+    Game().redisplay();
 }
 
 static void reshapeCallback(int w, int h)
@@ -126,10 +158,34 @@ static void specialKeyboardEventCallback(int key, int x, int y)
     Game().specialKeyboardEvent(key, x, y);
 }
 
+static void keyboardUpEventCallback(unsigned char key, int x, int y)
+{
+    Game().keyboardUpEvent(key, x, y);
+}
+
+static void specialKeyboardUpEventCallback(int key, int x, int y)
+{
+    Game().specialKeyboardUpEvent(key, x, y);
+}
+
+  // GLUT can't say when the window loses keyboard focus, so treat the
+  // pointer leaving the window, or the window being hidden or covered, as
+  // the moment any key-up events stop arriving
+static void entryCallback(int state)
+{
+    if (state == GLUT_LEFT)
+        Game().releaseHeldKeys();
+}
+
+static void windowStatusCallback(int state)
+{
+    if (state == GLUT_HIDDEN  ||  state == GLUT_FULLY_COVERED)
+        Game().releaseHeldKeys();
+}
+
 static void timerFuncCallback(int)
 {
-    Game().doSomething();
-    glutTimerFunc(MS_PER_FRAME, timerFuncCallback, 0);
+    Game().timerFired();
 }
 
 void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTitle)
@@ -137,12 +193,30 @@ void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTit
     gw->setController(this);
     m_gw = gw;
     setGameState(welcome);
-    m_lastKeyHit = INVALID_KEY;
+    m_inputsPerTick = 1;
+    releaseHeldKeys();
+    m_keyPressCount = 0;
+    m_inputLatencyCount = 0;
+    m_inputLatencyTotalMs = 0;
+    m_inputLatencyMaxMs = 0;
     m_singleStep = false;
-    m_curIntraFrameTick = 0;
+    m_turbo = false;
+    m_turboTicksPerFrame = 0;
     m_playerWon = false;
+    m_msPerTick = 1000.0 / DEFAULT_TICKS_PER_SECOND;
+    resetSimulationClock();
+    m_staticLayerBuilt = false;
+    m_staticLayerVersion = 0;
+    m_timerArmed = false;
+    m_needsRedraw = true;
+    m_hudList = 0;
+    m_hudDirty = true;
+    m_showPerfOverlay = false;
+    m_haveFrameStart = false;
+    m_countedLevel = 0;
 
     glutInit(&argc, argv);
+    parseCommandLine(argc, argv);
 
     glutInitDisplayMode(GLUT_RGB | GLUT_DEPTH | GLUT_DOUBLE);
     glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
@@ -153,45 +227,251 @@ void GameController::run(int argc, char* argv[], GameWorld* gw, string windowTit
 
     glutKeyboardFunc(keyboardEventCallback);
     glutSpecialFunc(specialKeyboardEventCallback);
+    glutKeyboardUpFunc(keyboardUpEventCallback);
+    glutSpecialUpFunc(specialKeyboardUpEventCallback);
+      // Held keys are tracked from their up and down events, so auto-repeat
+      // would only queue extra presses.  GLUT can only turn repeat off for
+      // every key, which suits the rest too: holding a toggle like z or p
+      // would otherwise flip it back and forth, and each press of a
+      // prompt, flame, landmine or vaccine key now acts exactly once.
+    glutIgnoreKeyRepeat(1);
+    glutEntryFunc(entryCallback);
+    glutWindowStatusFunc(windowStatusCallback);
     glutReshapeFunc(reshapeCallback);
-    glutDisplayFunc(doSomethingCallback);
-    glutTimerFunc(MS_PER_FRAME, timerFuncCallback, 0);
+    glutDisplayFunc(displayCallback);
+    wakeUp();
 
     glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
     glutMainLoop();
+    Trace::stop();
+    Metrics().stopServer();
+    if (!m_perfLogPath.empty())
+        writePerfLog();
     delete m_gw;
+    Log::shutdown();
+}
+
+  // glutInit() has already removed the options it understands
+void GameController::parseCommandLine(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--sim-rate")
+        {
+            int ticksPerSecond = (i + 1 < argc ? atoi(argv[++i]) : 0);
+            if (ticksPerSecond <= 0)
+            {
+                LOG_ERROR("options", "--sim-rate needs a positive number of ticks per second");
+                exit(1);
+            }
+            m_msPerTick = 1000.0 / ticksPerSecond;
+        }
+        else if (arg == "--inputs-per-tick")
+        {
+            int inputsPerTick = (i + 1 < argc ? atoi(argv[++i]) : -1);
+            if (inputsPerTick < 0)
+            {
+                LOG_ERROR("options", "--inputs-per-tick needs a number of keys, or 0 for all queued keys");
+                exit(1);
+            }
+            m_inputsPerTick = inputsPerTick;
+        }
+        else if (arg == "--perf-log")
+        {
+            if (i + 1 >= argc)
+            {
+                LOG_ERROR("options", "--perf-log needs a file name");
+                exit(1);
+            }
+            m_perfLogPath = argv[++i];
+        }
+        else if (arg == "--hw-counters")
+        {
+            if (!m_hwCounters.open())
+                LOG_WARNING("perf", "Hardware performance counters are not available, so none will be reported");
+        }
+        else if (arg == "--metrics-port")
+        {
+            int port = (i + 1 < argc ? atoi(argv[++i]) : 0);
+            if (port <= 0  ||  port > 65535)
+            {
+                LOG_ERROR("options", "--metrics-port needs a port number");
+                exit(1);
+            }
+            startMetrics(port);
+        }
+        else if (arg == "--trace")
+        {
+            if (i + 1 >= argc)
+            {
+                LOG_ERROR("options", "--trace needs a file name");
+                exit(1);
+            }
+            Trace::start(argv[++i]);
+        }
+        else if (arg == "--log-level")
+        {
+            Log::Level level;
+            if (i + 1 >= argc  ||  !Log::parseLevel(argv[++i], level))
+            {
+                LOG_ERROR("options", "--log-level needs one of debug, info, warning or error");
+                exit(1);
+            }
+            Log::setMinimumLevel(level);
+        }
+        else if (arg == "--turbo")
+        {
+            m_turbo = true;
+            if (i + 1 < argc)
+            {
+                char* end;
+                long ticksPerFrame = strtol(argv[i+1], &end, 10);
+                if (*end == '\0'  &&  ticksPerFrame > 0)
+                {
+                    m_turboTicksPerFrame = static_cast<int>(ticksPerFrame);
+                    i++;
+                }
+            }
+        }
+    }
+}
+
+  // Like getLastKey(), for keys read by the game world during a tick.  The
+  // time from each key press to the tick that reads it is recorded.
+bool GameController::getKeyForTick(int& value)
+{
+    InputEvent event;
+    if (!m_inputs.pop(event))
+        return false;
+
+    double latencyMs = chrono::duration<double, milli>(chrono::steady_clock::now() - event.timeReceived).count();
+    m_inputLatencyCount++;
+    m_inputLatencyTotalMs += latencyMs;
+    m_inputLatencyMaxMs = max(m_inputLatencyMaxMs, latencyMs);
+
+    value = event.key;
+    return true;
+}
+
+  // Run the state machine, then keep the timer going unless the game is
+  // only waiting for a key, in which case GLUT can sleep until one arrives
+void GameController::timerFired()
+{
+    m_timerArmed = false;
+    doSomething();
+    publishMetrics();
+    if (!isWaitingForInput())
+    {
+        m_timerArmed = true;
+        glutTimerFunc(MS_PER_FRAME, timerFuncCallback, 0);
+    }
+}
+
+void GameController::wakeUp()
+{
+    if (!m_timerArmed)
+    {
+        m_timerArmed = true;
+        glutTimerFunc(0, timerFuncCallback, 0);
+    }
+}
+
+  // The window was exposed or resized, so whatever is on screen must be redrawn
+void GameController::redisplay()
+{
+    m_needsRedraw = true;
+    wakeUp();
+}
+
+  // True when nothing will change on screen until the user presses a key:
+  // a prompt that has been drawn, or a single-stepped frame that has been
+  // drawn and is waiting for the next step
+bool GameController::isWaitingForInput() const
+{
+    if (m_needsRedraw  ||  !m_inputs.empty())
+        return false;
+    if (m_gameState == prompt)
+        return true;
+    return m_gameState == animate  &&  m_singleStep  &&  m_nextStateAfterAnimate == not_applicable;
 }
 
 void GameController::keyboardEvent(unsigned char key, int /* x */, int /* y */)
 {
     switch (key)
     {
-        case 'a': case '4': m_lastKeyHit = KEY_PRESS_LEFT;  break;
-        case 'd': case '6': m_lastKeyHit = KEY_PRESS_RIGHT; break;
-        case 'w': case '8': m_lastKeyHit = KEY_PRESS_UP;    break;
-        case 's': case '2': m_lastKeyHit = KEY_PRESS_DOWN;  break;
-        case 't':           m_lastKeyHit = KEY_PRESS_TAB;   break;
+        case 'a': case '4': pressKey(KEY_PRESS_LEFT);       break;
+        case 'd': case '6': pressKey(KEY_PRESS_RIGHT);      break;
+        case 'w': case '8': pressKey(KEY_PRESS_UP);         break;
+        case 's': case '2': pressKey(KEY_PRESS_DOWN);       break;
+        case 't':           m_inputs.push(KEY_PRESS_TAB);   break;
         case 'f':           m_singleStep = true;            break;
-        case 'r':           m_singleStep = false;           break;
+        case 'r':           m_singleStep = false;  resetSimulationClock();  break;
+        case 'z':           m_turbo = !m_turbo;    resetSimulationClock();  break;
+        case 'p':           m_showPerfOverlay = !m_showPerfOverlay;  m_needsRedraw = true;  break;
         case 'q': case 'Q': quitGame();                     break;
-        default:            m_lastKeyHit = key;             break;
+        default:            m_inputs.push(key);             break;
     }
+    wakeUp();
 }
 
 void GameController::specialKeyboardEvent(int key, int /* x */, int /* y */)
 {
     switch (key)
     {
-        case GLUT_KEY_LEFT:  m_lastKeyHit = KEY_PRESS_LEFT;  break;
-        case GLUT_KEY_RIGHT: m_lastKeyHit = KEY_PRESS_RIGHT; break;
-        case GLUT_KEY_UP:    m_lastKeyHit = KEY_PRESS_UP;    break;
-        case GLUT_KEY_DOWN:  m_lastKeyHit = KEY_PRESS_DOWN;  break;
-        default:             m_lastKeyHit = INVALID_KEY;     break;
+        case GLUT_KEY_LEFT:  pressKey(KEY_PRESS_LEFT);       break;
+        case GLUT_KEY_RIGHT: pressKey(KEY_PRESS_RIGHT);      break;
+        case GLUT_KEY_UP:    pressKey(KEY_PRESS_UP);         break;
+        case GLUT_KEY_DOWN:  pressKey(KEY_PRESS_DOWN);       break;
+        default:                                            break;
     }
+    wakeUp();
+}
+
+void GameController::keyboardUpEvent(unsigned char key, int /* x */, int /* y */)
+{
+    switch (key)
+    {
+        case 'a': case '4': releaseKey(KEY_PRESS_LEFT);  break;
+        case 'd': case '6': releaseKey(KEY_PRESS_RIGHT); break;
+        case 'w': case '8': releaseKey(KEY_PRESS_UP);    break;
+        case 's': case '2': releaseKey(KEY_PRESS_DOWN);  break;
+    }
+}
+
+void GameController::specialKeyboardUpEvent(int key, int /* x */, int /* y */)
+{
+    switch (key)
+    {
+        case GLUT_KEY_LEFT:  releaseKey(KEY_PRESS_LEFT);  break;
+        case GLUT_KEY_RIGHT: releaseKey(KEY_PRESS_RIGHT); break;
+        case GLUT_KEY_UP:    releaseKey(KEY_PRESS_UP);    break;
+        case GLUT_KEY_DOWN:  releaseKey(KEY_PRESS_DOWN);  break;
+    }
+}
+
+  // Queue a movement key and note that it is now held down
+void GameController::pressKey(int key)
+{
+    m_inputs.push(key);
+    m_keyPressOrder[key - KEY_PRESS_LEFT] = ++m_keyPressCount;
+}
+
+void GameController::releaseKey(int key)
+{
+    m_keyPressOrder[key - KEY_PRESS_LEFT] = 0;
+}
+
+  // Forget every held key, for when their key-up events can't be trusted
+  // to arrive
+void GameController::releaseHeldKeys()
+{
+    fill(begin(m_keyPressOrder), end(m_keyPressOrder), 0);
 }
 
 void GameController::playSound(int soundID)
 {
+    TRACE_SCOPE("playSound");
     if (soundID == SOUND_NONE)
     {
         SoundFX().abortClip();
@@ -215,6 +495,10 @@ void GameController::setGameStateAfterPrompting(GameControllerState s,
     m_mainMessage = mainMessage;
     m_secondMessage = secondMessage;
     m_nextStateAfterPrompt = s;
+    m_needsRedraw = true;
+      // A key held when play stopped shouldn't start Penelope walking as
+      // soon as the next level begins
+    releaseHeldKeys();
     setGameState(prompt);
 }
 
@@ -225,6 +509,7 @@ void GameController::quitGame()
 
 void GameController::doSomething()
 {
+    TRACE_SCOPE(STATE_TRACE_NAMES[m_gameState]);
     switch (m_gameState)
     {
         case not_applicable:
@@ -249,40 +534,37 @@ void GameController::doSomething()
                         "Press Enter to quit...");
                 }
                 else
+                {
+                      // Keys pressed during the prompt shouldn't carry into play
+                    m_inputs.discardPending();
+                    resetSimulationClock();
+                    m_moveCounters.reset();
+                    m_drawCounters.reset();
+                    m_countedLevel = m_gw->getLevel();
                     setGameState(makemove);
+                }
             }
             break;
         case makemove:
-            m_curIntraFrameTick = ANIMATION_POSITIONS_PER_TICK;
             m_nextStateAfterAnimate = not_applicable;
-            {
-                int status = m_gw->move();
-                if (status == GWSTATUS_PLAYER_DIED)
-                {
-                      // animate one last frame so the player can see what happened
-                    m_nextStateAfterAnimate = (m_gw->isGameOver() ? gameover : contgame);
-                }
-                else if (status == GWSTATUS_FINISHED_LEVEL)
-                {
-                    m_gw->advanceToNextLevel();
-                      // animate one last frame so the player can see what happened
-                    m_nextStateAfterAnimate = finishedlevel;
-                }
-            }
+            advanceSimulation();
+            m_needsRedraw = true;
             setGameState(animate);
             break;
         case animate:
-            displayGamePlay();
-            if (m_curIntraFrameTick-- <= 0)
+              // While single-stepping, the frame only changes after a step
+            if (m_needsRedraw  ||  !m_singleStep)
             {
-                if (m_nextStateAfterAnimate != not_applicable)
-                    setGameState(m_nextStateAfterAnimate);
-                else
-                {
-                    int key;
-                    if (!m_singleStep  ||  getLastKey(key))
-                        setGameState(makemove);
-                }
+                displayGamePlay();
+                m_needsRedraw = false;
+            }
+            if (m_nextStateAfterAnimate != not_applicable)
+                setGameState(m_nextStateAfterAnimate);
+            else
+            {
+                int key;
+                if (!m_singleStep  ||  getLastKey(key))
+                    setGameState(makemove);
             }
             break;
         case contgame:
@@ -294,6 +576,7 @@ void GameController::doSomething()
                                         "Press Enter to continue playing...");
             break;
         case cleanup:
+            reportHardwareCounters();
             m_gw->cleanUp();
             setGameState(init);
             break;
@@ -303,11 +586,16 @@ void GameController::doSomething()
                 oss << (m_playerWon ? "You won the game!" : "Game Over!")
                     << " Final score: " << m_gw->getScore() << "!";
                 setGameStateAfterPrompting(quit, oss.str(), "Press Enter to quit...");
+                reportHardwareCounters();
                 m_gw->cleanUp();
             }
             break;
         case prompt:
-            drawPrompt(m_mainMessage, m_secondMessage);
+            if (m_needsRedraw)
+            {
+                drawPrompt(m_mainMessage, m_secondMessage);
+                m_needsRedraw = false;
+            }
             {
                 int key;
                 if (getLastKey(key) && key == '\r')
@@ -315,14 +603,158 @@ void GameController::doSomething()
             }
             break;
         case quit:
+            if (m_inputLatencyCount > 0)
+            {
+                LOG_INFO("input", "Input latency")
+                    .field("keys", m_inputLatencyCount)
+                    .field("mean_ms", m_inputLatencyTotalMs / m_inputLatencyCount)
+                    .field("max_ms", m_inputLatencyMaxMs)
+                    .field("dropped", m_inputs.droppedCount());
+            }
             SoundFX().abortClip();
             glutLeaveMainLoop();
             break;
     }
 }
 
+  // Start timing afresh, with one tick due straight away
+void GameController::resetSimulationClock()
+{
+    m_lastClockTime = chrono::steady_clock::now();
+    m_tickAccumulator = m_msPerTick;
+}
+
+  // Run however many ticks have come due since the last call.  In single
+  // step mode, each call runs exactly one tick; in turbo mode, it runs a
+  // whole batch regardless of the clock.  Only the last tick run is ever
+  // drawn, so only it is copied into a snapshot.
+  //
+  // This runs on the GLUT thread, between frames, so simulating and drawing
+  // still take turns rather than overlapping.  Drawing only reads snapshots,
+  // but move() still calls back into this class for keys, sounds and the
+  // stat text, and the state machine in doSomething() waits on the outcome
+  // of each batch.  All of those would need handing over between threads
+  // before move() could run on a thread of its own.
+void GameController::advanceSimulation()
+{
+    auto now = chrono::steady_clock::now();
+    m_tickAccumulator += chrono::duration<double, milli>(now - m_lastClockTime).count();
+    m_lastClockTime = now;
+
+    if (m_singleStep)
+    {
+        m_tickAccumulator = 0;
+        simulateTick();
+        publishSnapshot();
+        return;
+    }
+
+    if (m_turbo)
+    {
+          // Stop the batch as soon as a tick ends the level, so the usual
+          // final frame and prompt follow straight after it
+        auto deadline = now + chrono::duration<double, milli>(TURBO_FRAME_BUDGET_MS);
+        int ticks = 0;
+        while (simulateTick())
+        {
+            ticks++;
+            if (m_turboTicksPerFrame > 0 ? ticks == m_turboTicksPerFrame
+                                         : chrono::steady_clock::now() >= deadline)
+                break;
+        }
+        publishSnapshot();
+        m_tickAccumulator = 0;
+        m_lastClockTime = chrono::steady_clock::now();
+        return;
+    }
+
+    int ticks = 0;
+    while (m_tickAccumulator >= m_msPerTick)
+    {
+        if (ticks == MAX_TICKS_PER_UPDATE)
+        {
+              // Too far behind to catch up, so let the game slow down instead
+            m_tickAccumulator = fmod(m_tickAccumulator, m_msPerTick);
+            break;
+        }
+        m_tickAccumulator -= m_msPerTick;
+        ticks++;
+        if (!simulateTick())
+            break;
+    }
+    if (ticks > 0)
+        publishSnapshot();
+}
+
+  // Returns false if the tick ended the level, in which case
+  // m_nextStateAfterAnimate says what to do after showing the final frame
+bool GameController::simulateTick()
+{
+    TRACE_SCOPE("simulateTick");
+    GraphObject::beginSimulationStep();
+    HardwareCounters::Sample countsBefore, countsAfter;
+    bool counting = m_hwCounters.read(countsBefore);
+    auto moveStart = chrono::steady_clock::now();
+    int status = m_gw->move();
+    m_moveTime.addSample(chrono::duration<double, milli>(chrono::steady_clock::now() - moveStart).count());
+    if (counting  &&  m_hwCounters.read(countsAfter))
+        m_moveCounters.add(countsBefore, countsAfter);
+    else
+        m_moveCounters.markUnread();
+
+    if (status == GWSTATUS_PLAYER_DIED)
+    {
+          // animate one last frame so the player can see what happened
+        m_nextStateAfterAnimate = (m_gw->isGameOver() ? gameover : contgame);
+        return false;
+    }
+    else if (status == GWSTATUS_FINISHED_LEVEL)
+    {
+        m_gw->advanceToNextLevel();
+          // animate one last frame so the player can see what happened
+        m_nextStateAfterAnimate = finishedlevel;
+        return false;
+    }
+    return true;
+}
+
+  // Hand the objects as they stand to the drawing side
+void GameController::publishSnapshot()
+{
+    TRACE_SCOPE("captureSnapshot");
+    GraphObject::captureSnapshot(m_snapshots.back());
+    m_snapshots.publish();
+}
+
+  // How far through the next tick real time has got, used to draw moving
+  // objects between their previous and current positions
+double GameController::interpolationFactor() const
+{
+    if (m_singleStep  ||  m_turbo  ||  m_nextStateAfterAnimate != not_applicable)
+        return 1.0;
+
+    double pending = m_tickAccumulator +
+        chrono::duration<double, milli>(chrono::steady_clock::now() - m_lastClockTime).count();
+    return min(1.0, pending / m_msPerTick);
+}
+
+void GameController::plotSpriteRecord(const SpriteRecord& r, double x, double y)
+{
+    int frame = r.animationNumber % m_spriteManager.getNumFrames(r.imageID);
+    m_spriteManager.plotSprite(r.imageID, frame, x, y, r.direction, r.size);
+}
+
 void GameController::displayGamePlay()
 {
+    TRACE_SCOPE("displayGamePlay");
+    auto frameStart = chrono::steady_clock::now();
+    if (m_haveFrameStart)
+        m_frameTime.addSample(chrono::duration<double, milli>(frameStart - m_lastFrameStart).count());
+    m_lastFrameStart = frameStart;
+    m_haveFrameStart = true;
+    HardwareCounters::Sample countsBefore, countsAfter;
+    bool counting = m_hwCounters.read(countsBefore);
+
     glEnable(GL_DEPTH_TEST); // must be done each time before displaying graphics or gets disabled for some reason
     glLoadIdentity();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -335,18 +767,231 @@ void GameController::displayGamePlay()
 #pragma GCC diagnostic pop
 #endif
 
-    GraphObject::drawAllObjects(
-        [=](int imageID, int animationNumber, double x, double y, int angle, double size)
+      // Draw only from the latest snapshot, never from the live objects
+    const RenderSnapshot* snapshot = m_snapshots.acquire();
+    if (snapshot != nullptr)
+    {
+          // Walls, pits and exits are only re-plotted when one is added or removed
+        if (!m_staticLayerBuilt  ||  m_staticLayerVersion != snapshot->staticLayerVersion)
         {
-            int frame = animationNumber % m_spriteManager.getNumFrames(imageID);
-            m_spriteManager.plotSprite(imageID, frame, x, y, angle, size);
-        });
+            TRACE_SCOPE("plot static layer");
+            m_spriteManager.beginStaticLayer();
+            for (const SpriteRecord& r : snapshot->staticSprites)
+                plotSpriteRecord(r, r.x, r.y);
+            m_spriteManager.endStaticLayer();
+            m_staticLayerBuilt = true;
+            m_staticLayerVersion = snapshot->staticLayerVersion;
+        }
+        m_spriteManager.drawStaticLayer();
 
-    drawScoreAndLives(m_gameStatText);
+          // Objects that moved in the latest tick are drawn part way along
+        TRACE_SCOPE("plot sprites");
+        double interpolation = interpolationFactor();
+        m_spriteManager.beginBatch();
+        for (const SpriteRecord& r : snapshot->sprites)
+        {
+            if (r.movedThisTick)
+                plotSpriteRecord(r, r.prevX + (r.x - r.prevX) * interpolation,
+                                    r.prevY + (r.y - r.prevY) * interpolation);
+            else
+                plotSpriteRecord(r, r.x, r.y);
+        }
+        m_spriteManager.flushBatch();
+    }
+
+      // The stat line only changes now and then, so its strokes are kept in
+      // a display list that is re-recorded when the text changes
+    if (m_hudDirty  ||  m_hudList == 0)
+    {
+        if (m_hudList == 0)
+            m_hudList = glGenLists(1);
+        glNewList(m_hudList, GL_COMPILE);
+        strokeScoreAndLives(m_gameStatText);
+        glEndList();
+        m_hudDirty = false;
+    }
+    drawScoreAndLives(m_hudList);
+
+    if (m_showPerfOverlay)
+        drawPerfOverlay();
 
+    m_drawTime.addSample(chrono::duration<double, milli>(chrono::steady_clock::now() - frameStart).count());
+    if (counting  &&  m_hwCounters.read(countsAfter))
+        m_drawCounters.add(countsBefore, countsAfter);
+    else
+        m_drawCounters.markUnread();
+    TRACE_SCOPE("glutSwapBuffers");
     glutSwapBuffers();
 }
 
+  // Timings for the last few seconds in the top left corner, with a bar for
+  // each recent frame time along the bottom
+void GameController::drawPerfOverlay()
+{
+    static const double LEFT = -4.0;
+    static const double TOP = 3.4;
+    static const double LINE_HEIGHT = .2;
+    static const double BOTTOM = -3.9;
+    static const double BAR_SPACING = .016;
+    static const double HEIGHT_PER_MS = .05;
+
+    struct { const char* name; const PerfMetric* metric; } rows[] = {
+        { "frame", &m_frameTime },
+        { "move ", &m_moveTime },
+        { "draw ", &m_drawTime },
+    };
+
+    glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT);
+    glDisable(GL_TEXTURE_2D);
+    glColor3f(1.0, 1.0, 0.0);
+
+    char line[100];
+    double y = TOP;
+    for (const auto& row : rows)
+    {
+        snprintf(line, sizeof(line), "%s %6.2f ms  p50 %6.2f  p99 %6.2f  max %6.2f", row.name,
+                 row.metric->last(), row.metric->recentPercentile(.5),
+                 row.metric->recentPercentile(.99), row.metric->recentMax());
+        outputStroke(LEFT, y, SCORE_Z, .8, line);
+        y -= LINE_HEIGHT;
+    }
+    snprintf(line, sizeof(line), "actors %d", m_gw->actorCount());
+    outputStroke(LEFT, y, SCORE_Z, .8, line);
+    if (m_hwCounters.isOpen())
+    {
+          // Counts for the latest tick, with cycles and instructions in
+          // thousands, unless that tick's counts were skipped
+        const HardwareCounters::Sample& tick = m_moveCounters.last();
+        if (m_moveCounters.lastSkipped())
+            snprintf(line, sizeof(line), "tick counts skipped: counters shared or unreadable");
+        else
+            snprintf(line, sizeof(line), "tick kcycles %llu  kinstr %llu  cache miss %llu  branch miss %llu",
+                     tick.counts[HardwareCounters::CYCLES] / 1000, tick.counts[HardwareCounters::INSTRUCTIONS] / 1000,
+                     tick.counts[HardwareCounters::CACHE_MISSES], tick.counts[HardwareCounters::BRANCH_MISSES]);
+        y -= LINE_HEIGHT;
+        outputStroke(LEFT, y, SCORE_Z, .8, line);
+    }
+
+      // Green bars up to the frame time we aim for, red above it
+    double targetMs = m_msPerTick;
+    glLoadIdentity();
+    glBegin(GL_LINES);
+    for (int age = 0; age < m_frameTime.recentCount(); age++)
+    {
+        double ms = m_frameTime.recentSample(age);
+        double x = LEFT + (PerfMetric::WINDOW - 1 - age) * BAR_SPACING;
+        double split = min(ms, targetMs);
+        glColor3f(0.0, 1.0, 0.0);
+        glVertex3d(x, BOTTOM, SCORE_Z);
+        glVertex3d(x, BOTTOM + split * HEIGHT_PER_MS, SCORE_Z);
+        if (ms > targetMs)
+        {
+            glColor3f(1.0, 0.0, 0.0);
+            glVertex3d(x, BOTTOM + split * HEIGHT_PER_MS, SCORE_Z);
+            glVertex3d(x, BOTTOM + ms * HEIGHT_PER_MS, SCORE_Z);
+        }
+    }
+    glEnd();
+
+    glPopAttrib();
+}
+
+void GameController::writePerfLog() const
+{
+    ofstream log(m_perfLogPath);
+    if (!log)
+    {
+        LOG_ERROR("perf", "Cannot write the performance log").field("file", m_perfLogPath);
+        return;
+    }
+    m_frameTime.writeSummary(log, "frame");
+    m_moveTime.writeSummary(log, "move");
+    m_drawTime.writeSummary(log, "draw");
+}
+
+void GameController::startMetrics(int port)
+{
+    if (!Metrics().startServer(port))
+    {
+        LOG_ERROR("metrics", "Cannot serve metrics").field("port", port);
+        exit(1);
+    }
+
+    MetricsRegistry& r = Metrics();
+    m_metrics.ticks = &r.counter("zombiedash_ticks_total", "Simulation ticks run");
+    m_metrics.frames = &r.counter("zombiedash_frames_total", "Frames drawn");
+    m_metrics.ticksPerSecond = &r.gauge("zombiedash_ticks_per_second", "Ticks run per second since the last update");
+    for (int q = 0; q < 3; q++)
+    {
+        ostringstream label;
+        label << "quantile=\"" << TICK_QUANTILES[q] << "\"";
+        m_metrics.tickQuantiles[q] = &r.summary("zombiedash_tick_seconds",
+            "Time taken by each call of move(), over the last few seconds", label.str());
+    }
+    m_metrics.tickSecondsSum = &r.summary("zombiedash_tick_seconds_sum", "");
+    m_metrics.tickSecondsCount = &r.summary("zombiedash_tick_seconds_count", "");
+    m_metrics.level = &r.gauge("zombiedash_level", "Level being played");
+    m_metrics.score = &r.gauge("zombiedash_score", "Current score");
+    m_metrics.lives = &r.gauge("zombiedash_lives", "Lives left");
+    m_metrics.inputQueueDepth = &r.gauge("zombiedash_input_queue_depth", "Key presses waiting to be read");
+    m_metrics.droppedKeys = &r.counter("zombiedash_input_dropped_total", "Key presses dropped because the queue was full");
+#ifdef ZD_TRACK_ALLOCATIONS
+    m_metrics.allocations = &r.counter("zombiedash_allocations_total", "Heap allocations made");
+#else
+    m_metrics.allocations = nullptr;
+#endif
+    m_lastMetricsUpdate = chrono::steady_clock::now();
+    m_ticksAtLastMetricsUpdate = 0;
+}
+
+  // Only the game thread writes the metrics, and the server thread reads
+  // them without locking
+void GameController::publishMetrics()
+{
+    if (!Metrics().isServing())
+        return;
+    auto now = chrono::steady_clock::now();
+    double elapsedMs = chrono::duration<double, milli>(now - m_lastMetricsUpdate).count();
+    if (elapsedMs < METRICS_UPDATE_MS)
+        return;
+
+    long ticks = m_moveTime.count();
+    m_metrics.ticks->set(ticks);
+    m_metrics.frames->set(m_drawTime.count());
+    m_metrics.ticksPerSecond->set((ticks - m_ticksAtLastMetricsUpdate) * 1000 / elapsedMs);
+    for (int q = 0; q < 3; q++)
+        m_metrics.tickQuantiles[q]->set(m_moveTime.recentPercentile(TICK_QUANTILES[q]) / 1000);
+    m_metrics.tickSecondsSum->set(m_moveTime.total() / 1000);
+    m_metrics.tickSecondsCount->set(ticks);
+    m_metrics.level->set(m_gw->getLevel());
+    m_metrics.score->set(m_gw->getScore());
+    m_metrics.lives->set(m_gw->getLives());
+    m_metrics.inputQueueDepth->set(m_inputs.size());
+    m_metrics.droppedKeys->set(m_inputs.droppedCount());
+#ifdef ZD_TRACK_ALLOCATIONS
+    AllocationTracker::Counts allocations;
+    AllocationTracker::read(allocations);
+    m_metrics.allocations->set(allocations.totalAllocations());
+#endif
+
+    m_lastMetricsUpdate = now;
+    m_ticksAtLastMetricsUpdate = ticks;
+}
+
+  // Averages per tick and per frame over the level just played
+void GameController::reportHardwareCounters()
+{
+    if (!m_hwCounters.isOpen())
+        return;
+    ostringstream report;
+    report << "Hardware counters for level " << m_countedLevel << ":\n";
+    m_moveCounters.writeSummary(report, "  move", m_hwCounters);
+    m_drawCounters.writeSummary(report, "  draw", m_hwCounters);
+    Log::writeLines(Log::LEVEL_INFO, "perf", report.str());
+    m_moveCounters.reset();
+    m_drawCounters.reset();
+}
+
 void GameController::reshape (int w, int h)
 {
     glViewport (0, 0, (GLsizei) w, (GLsizei) h);
@@ -382,17 +1027,17 @@ static void doOutputStroke(double x, double y, double z, double size, const char
     glPopMatrix();
 }
 
-//static void outputStroke(double x, double y, double z, double size, const char* str)
-//{
-//  doOutputStroke(x, y, z, size, str, false);
-//}
+static void outputStroke(double x, double y, double z, double size, const char* str)
+{
+    doOutputStroke(x, y, z, size, str, false);
+}
 
 static void outputStrokeCentered(double y, double z, const char* str)
 {
     doOutputStroke(0, y, z, 1, str, true);
 }
 
-static void drawPrompt(string mainMessage, string secondMessage)
+static void drawPrompt(const string& mainMessage, const string& secondMessage)
 {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glColor3f (1.0, 1.0, 1.0);
@@ -402,7 +1047,12 @@ static void drawPrompt(string mainMessage, string secondMessage)
     glutSwapBuffers();
 }
 
-static void drawScoreAndLives(string gameStatText)
+static void strokeScoreAndLives(const string& gameStatText)
+{
+    outputStrokeCentered(SCORE_Y, SCORE_Z, gameStatText.c_str());
+}
+
+static void drawScoreAndLives(GLuint hudList)
 {
     static int RATE = 1;
     static GLfloat rgb[3] =
@@ -417,5 +1067,5 @@ static void drawScoreAndLives(string gameStatText)
         rgb[k] = static_cast<GLfloat>(strength);
     }
     glColor3f(rgb[0], rgb[1], rgb[2]);
-    outputStrokeCentered(SCORE_Y, SCORE_Z, gameStatText.c_str());
+    glCallList(hudList);
 }
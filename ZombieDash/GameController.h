@@ -2,10 +2,17 @@
 #define GAMECONTROLLER_H_
 
 #include "SpriteManager.h"
+#include "RenderSnapshot.h"
+#include "InputQueue.h"
+#include "PerfStats.h"
+#include "HardwareCounters.h"
+#include "Metrics.h"
+#include "GameConstants.h"
 #include <string>
 #include <map>
 #include <iostream>
 #include <sstream>
+#include <chrono>
 
 const int INVALID_KEY = 0;
 
@@ -19,27 +26,66 @@ class GameController
 
     bool getLastKey(int& value)
     {
-        if (m_lastKeyHit != INVALID_KEY)
+        InputEvent event;
+        if (m_inputs.pop(event))
         {
-            value = m_lastKeyHit;
-            m_lastKeyHit = INVALID_KEY;
+            value = event.key;
             return true;
         }
         return false;
     }
 
+    bool getKeyForTick(int& value);
+
+      // Held state is only tracked for the movement keys
+    bool isKeyHeld(int key) const
+    {
+        int index = key - KEY_PRESS_LEFT;
+        return index >= 0  &&  index < NUM_HELD_KEYS  &&  m_keyPressOrder[index] != 0;
+    }
+
+    bool getHeldKey(int& value) const
+    {
+        int newest = -1;
+        for (int k = 0; k < NUM_HELD_KEYS; k++)
+        {
+            if (m_keyPressOrder[k] != 0  &&  (newest < 0  ||  m_keyPressOrder[k] > m_keyPressOrder[newest]))
+                newest = k;
+        }
+        if (newest < 0)
+            return false;
+        value = KEY_PRESS_LEFT + newest;
+        return true;
+    }
+
+      // How many queued keys the player may act on in one tick, or
+      // ALL_QUEUED_INPUTS
+    int inputsPerTick() const
+    {
+        return m_inputsPerTick;
+    }
+
     void playSound(int soundID);
 
-    void setGameStatText(std::string text)
+    void setGameStatText(const std::string& text)
     {
-        m_gameStatText = text;
+        if (text != m_gameStatText)
+        {
+            m_gameStatText = text;
+            m_hudDirty = true;
+        }
     }
 
     void doSomething();
+    void timerFired();
+    void redisplay();
 
     void reshape(int w, int h);
     void keyboardEvent(unsigned char key, int x, int y);
     void specialKeyboardEvent(int key, int x, int y);
+    void keyboardUpEvent(unsigned char key, int x, int y);
+    void specialKeyboardUpEvent(int key, int x, int y);
+    void releaseHeldKeys();
 
     void quitGame();
 
@@ -57,24 +103,91 @@ private:
     GameControllerState m_gameState;
     GameControllerState m_nextStateAfterPrompt;
     GameControllerState m_nextStateAfterAnimate;
-    int         m_lastKeyHit;
+    InputQueue  m_inputs;
+    static const int NUM_HELD_KEYS = 4;     // KEY_PRESS_LEFT through KEY_PRESS_DOWN
+    unsigned int m_keyPressOrder[NUM_HELD_KEYS];    // 0 if up, else when it was pressed
+    unsigned int m_keyPressCount;
+    int         m_inputsPerTick;
+    long        m_inputLatencyCount;
+    double      m_inputLatencyTotalMs;
+    double      m_inputLatencyMaxMs;
     bool        m_singleStep;
+    bool        m_timerArmed;
+    bool        m_needsRedraw;          // something on screen is out of date
+    bool        m_turbo;
+    int         m_turboTicksPerFrame;   // 0 means as many as fit in the frame budget
     std::string m_gameStatText;
     std::string m_mainMessage;
     std::string m_secondMessage;
-    int         m_curIntraFrameTick;
+    double      m_msPerTick;
+    double      m_tickAccumulator;      // real time not yet simulated, in ms
+    std::chrono::steady_clock::time_point m_lastClockTime;
     using SoundMapType = std::map<int, std::string>;
     using DrawMapType =  std::map<int, std::string>;
     SoundMapType  m_soundMap;
     bool          m_playerWon;
     SpriteManager m_spriteManager;
-
+      // Filled by advanceSimulation and read by displayGamePlay, both
+      // still on the GLUT thread; see advanceSimulation
+    SnapshotBuffer m_snapshots;
+    bool          m_showPerfOverlay;
+    std::string   m_perfLogPath;        // where to write the timing summary on exit, if set
+    PerfMetric    m_frameTime;          // from the start of one frame to the start of the next
+    PerfMetric    m_moveTime;           // each call of m_gw->move()
+    PerfMetric    m_drawTime;           // issuing the GL calls for a frame, up to the buffer swap
+    std::chrono::steady_clock::time_point m_lastFrameStart;
+    HardwareCounters m_hwCounters;      // only opened if asked for on the command line
+    CounterTally  m_moveCounters;       // each call of m_gw->move() on the current level
+    CounterTally  m_drawCounters;       // each frame drawn on the current level
+    int           m_countedLevel;       // the level m_moveCounters and m_drawCounters cover
+
+      // Handles on the metrics published when --metrics-port is given
+    struct PublishedMetrics
+    {
+        Metric* ticks;
+        Metric* frames;
+        Metric* ticksPerSecond;
+        Metric* tickQuantiles[3];
+        Metric* tickSecondsSum;
+        Metric* tickSecondsCount;
+        Metric* level;
+        Metric* score;
+        Metric* lives;
+        Metric* inputQueueDepth;
+        Metric* droppedKeys;
+        Metric* allocations;
+    };
+    PublishedMetrics m_metrics;
+    std::chrono::steady_clock::time_point m_lastMetricsUpdate;
+    long          m_ticksAtLastMetricsUpdate;
+    bool          m_haveFrameStart;
+    GLuint        m_hudList;            // display list stroking m_gameStatText
+    bool          m_hudDirty;
+    bool          m_staticLayerBuilt;
+    unsigned int  m_staticLayerVersion;    // GraphObject static layer version last drawn into it
+
+    void pressKey(int key);
+    void releaseKey(int key);
+    void wakeUp();
+    bool isWaitingForInput() const;
     void setGameState(GameControllerState s);
     void setGameStateAfterPrompting(GameControllerState s,
                             std::string mainMessage, std::string secondMessage);
 
+    void parseCommandLine(int argc, char* argv[]);
     void initDrawersAndSounds();
+    void resetSimulationClock();
+    void advanceSimulation();
+    bool simulateTick();
+    void publishSnapshot();
+    double interpolationFactor() const;
+    void plotSpriteRecord(const SpriteRecord& r, double x, double y);
     void displayGamePlay();
+    void drawPerfOverlay();
+    void writePerfLog() const;
+    void reportHardwareCounters();
+    void startMetrics(int port);
+    void publishMetrics();
 };
 
 inline GameController& Game()
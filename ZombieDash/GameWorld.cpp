@@ -6,7 +6,7 @@ using namespace std;
 
 bool GameWorld::getKey(int& value)
 {
-    bool gotKey = m_controller->getLastKey(value);
+    bool gotKey = m_controller->getKeyForTick(value);
 
     if (gotKey)
     {
@@ -16,12 +16,28 @@ bool GameWorld::getKey(int& value)
     return gotKey;
 }
 
+bool GameWorld::isKeyHeld(int key) const
+{
+    return m_controller->isKeyHeld(key);
+}
+
+  // The most recently pressed of the keys still held down
+bool GameWorld::getHeldKey(int& value) const
+{
+    return m_controller->getHeldKey(value);
+}
+
+int GameWorld::inputsPerTick() const
+{
+    return m_controller->inputsPerTick();
+}
+
 void GameWorld::playSound(int soundID)
 {
     m_controller->playSound(soundID);
 }
 
-void GameWorld::setGameStatText(string text)
+void GameWorld::setGameStatText(const string& text)
 {
     m_controller->setGameStatText(text);
 }
@@ -5,6 +5,7 @@
 #include <string>
 
 const int START_PLAYER_LIVES = 3;
+const int ALL_QUEUED_INPUTS = 0;    // inputsPerTick() value meaning no limit
 
 class GameController;
 
@@ -26,9 +27,18 @@ public:
     virtual int move() = 0;
     virtual void cleanUp() = 0;
 
-    void setGameStatText(std::string text);
+      // Number of live game objects, for the performance overlay
+    virtual int actorCount() const
+    {
+        return 0;
+    }
+
+    void setGameStatText(const std::string& text);
 
     bool getKey(int& value);
+    bool isKeyHeld(int key) const;
+    bool getHeldKey(int& value) const;
+    int inputsPerTick() const;
     void playSound(int soundID);
 
     int getLevel() const
@@ -3,12 +3,12 @@
 
 #include "SpriteManager.h"
 #include "GameConstants.h"
+#include "RenderSnapshot.h"
+#include "AllocationTracker.h"
 
-#include <set>
+#include <vector>
 #include <cmath>
 
-const int ANIMATION_POSITIONS_PER_TICK = 1;
-
 using Direction = int;
 
 class GraphObject
@@ -21,18 +21,26 @@ class GraphObject
     static const int down = 270;
 
     GraphObject(int imageID, double startX, double startY, Direction dir = 0, int depth = 0, double size = 1.0)
-     : m_imageID(imageID), m_x(startX), m_y(startY), m_destX(startX), m_destY(startY),
-       m_animationNumber(0), m_direction(dir), m_depth(depth), m_size(size)
+     : m_imageID(imageID), m_destX(startX), m_destY(startY),
+       m_prevX(startX), m_prevY(startY), m_moveStep(simulationStep()), m_animationNumber(0), m_direction(dir), m_depth(depth), m_size(size)
     {
         if (m_size <= 0)
             m_size = 1;
+        if (m_depth < 0  ||  m_depth >= NUM_DEPTHS)
+            m_depth = 0;
 
-        getGraphObjects(m_depth).insert(this);
+        addToLayer(getGraphObjects(m_depth));
     }
 
     virtual ~GraphObject()
     {
-        getGraphObjects(m_depth).erase(this);
+        if (m_static)
+        {
+            removeFromLayer(getStaticGraphObjects(m_depth));
+            staticLayerVersion()++;
+        }
+        else
+            removeFromLayer(getGraphObjects(m_depth));
     }
 
     double getX() const
@@ -49,6 +57,13 @@ class GraphObject
 
     virtual void moveTo(double x, double y)
     {
+        if (m_moveStep != simulationStep())
+        {
+              // First move this tick, so remember where to draw it moving from
+            m_prevX = m_destX;
+            m_prevY = m_destY;
+            m_moveStep = simulationStep();
+        }
         m_destX = x;
         m_destY = y;
         increaseAnimationNumber();
@@ -84,16 +99,34 @@ class GraphObject
         m_animationNumber++;
     }
 
-    template<typename Func>
-    static void drawAllObjects(Func plotFunc)
+      // Call before each tick of the simulation, so objects moved during it
+      // can be drawn part way between their old and new positions
+    static void beginSimulationStep()
+    {
+        simulationStep()++;
+    }
+
+      // Copy what is needed to draw every object into snapshot, so it can
+      // be drawn later without touching the objects themselves.  The static
+      // sprites are only recopied when the static layer has changed.
+    static void captureSnapshot(RenderSnapshot& snapshot)
     {
+        snapshot.sprites.clear();
         for (int depth = NUM_DEPTHS - 1; depth >= 0; depth--)
         {
-            for (GraphObject* go : getGraphObjects(depth))
+            for (const GraphObject* go : getGraphObjects(depth))
+                snapshot.sprites.push_back(go->makeRecord());
+        }
+
+        if (snapshot.staticLayerVersion != staticLayerVersion())
+        {
+            snapshot.staticSprites.clear();
+            for (int depth = NUM_DEPTHS - 1; depth >= 0; depth--)
             {
-                go->animate();
-                plotFunc(go->m_imageID, go->m_animationNumber, go->m_x, go->m_y, go->m_direction, go->m_size);
+                for (const GraphObject* go : getStaticGraphObjects(depth))
+                    snapshot.staticSprites.push_back(go->makeRecord());
             }
+            snapshot.staticLayerVersion = staticLayerVersion();
         }
     }
 
@@ -101,45 +134,104 @@ class GraphObject
     GraphObject(const GraphObject&) = delete;
     GraphObject& operator=(const GraphObject&) = delete;
 
+  protected:
+
+      // For objects that never move, turn or animate once created, such as
+      // walls.  They are drawn into a cached background layer instead of
+      // being re-plotted every frame.
+    void setStatic()
+    {
+        if (m_static)
+            return;
+
+        removeFromLayer(getGraphObjects(m_depth));
+        addToLayer(getStaticGraphObjects(m_depth));
+        m_static = true;
+        staticLayerVersion()++;
+    }
+
   private:
 
     static const int NUM_DEPTHS = 4;
     int     m_imageID;
-    double  m_x;
-    double  m_y;
     double  m_destX;
     double  m_destY;
+    double  m_prevX;
+    double  m_prevY;
+    unsigned int m_moveStep;    // simulation step in which it last moved
     int     m_animationNumber;
     Direction   m_direction;
     int     m_depth;
     double  m_size;
+    bool    m_static = false;
+    size_t  m_layerIndex;   // position in its layer's list, for constant time removal
 
-    void animate()
+    SpriteRecord makeRecord() const
     {
-        m_x = m_destX;
-        m_y = m_destY;
-        //moveALittle(m_x, m_destX);
-        //moveALittle(m_y, m_destY);
+        SpriteRecord record;
+        record.imageID = m_imageID;
+        record.animationNumber = m_animationNumber;
+        record.x = m_destX;
+        record.y = m_destY;
+        record.prevX = m_prevX;
+        record.prevY = m_prevY;
+        record.direction = m_direction;
+        record.depth = m_depth;
+        record.size = m_size;
+        record.movedThisTick = (m_moveStep == simulationStep());
+        return record;
     }
 
-    void moveALittle(double& from, double& to)
+      // Each layer is an unordered list of the objects at one depth.  Objects
+      // remember their position in it, so removal swaps the last object into
+      // the hole instead of searching or shifting.
+    using Layer = std::vector<GraphObject*>;
+    static const size_t INITIAL_LAYER_CAPACITY = 1024;
+
+    void addToLayer(Layer& layer)
     {
-        static const double DISTANCE = 1.0/ANIMATION_POSITIONS_PER_TICK;
-        if (to - from >= DISTANCE)
-            from += DISTANCE;
-        else if (from - to >= DISTANCE)
-            from -= DISTANCE;
-        else
-            from = to;
+        ALLOCATION_PHASE(PHASE_LAYER_INSERT);
+        m_layerIndex = layer.size();
+        layer.push_back(this);
     }
 
-    static std::set<GraphObject*>& getGraphObjects(int depth)
+    void removeFromLayer(Layer& layer)
     {
-        static std::set<GraphObject*> graphObjects[NUM_DEPTHS];
-        if (depth < NUM_DEPTHS)
-            return graphObjects[depth];
-        else
-            return graphObjects[0];     // empty;
+        GraphObject* last = layer.back();
+        layer[m_layerIndex] = last;
+        last->m_layerIndex = m_layerIndex;
+        layer.pop_back();
+    }
+
+    static Layer* makeLayers()
+    {
+        static Layer layers[2 * NUM_DEPTHS];   // dynamic layers, then static ones
+        for (Layer& layer : layers)
+            layer.reserve(INITIAL_LAYER_CAPACITY);
+        return layers;
+    }
+
+    static Layer& getGraphObjects(int depth)
+    {
+        static Layer* layers = makeLayers();
+        return layers[depth];
+    }
+
+    static Layer& getStaticGraphObjects(int depth)
+    {
+        return getGraphObjects(NUM_DEPTHS + depth);
+    }
+
+    static unsigned int& simulationStep()
+    {
+        static unsigned int step = 0;
+        return step;
+    }
+
+    static unsigned int& staticLayerVersion()
+    {
+        static unsigned int version = 0;
+        return version;
     }
 };
 
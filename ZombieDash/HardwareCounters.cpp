@@ -0,0 +1,171 @@
+#include "HardwareCounters.h"
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const char* const EVENT_NAMES[HardwareCounters::NUM_EVENTS] = {
+        "cycles", "instructions", "cache misses", "branch misses"
+    };
+
+#ifdef __linux__
+    const uint64_t EVENT_CONFIGS[HardwareCounters::NUM_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+      // Counts for this thread in user space, on any CPU
+    int openCounter(uint64_t config, int groupFd)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = (groupFd < 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+#endif
+}
+
+HardwareCounters::HardwareCounters()
+ : m_groupFd(-1), m_numOpen(0)
+{
+    for (int e = 0; e < NUM_EVENTS; e++)
+    {
+        m_fds[e] = -1;
+        m_slot[e] = -1;
+    }
+}
+
+HardwareCounters::~HardwareCounters()
+{
+#ifdef __linux__
+    for (int e = 0; e < NUM_EVENTS; e++)
+    {
+        if (m_fds[e] >= 0)
+            close(m_fds[e]);
+    }
+#endif
+}
+
+bool HardwareCounters::open()
+{
+#ifdef __linux__
+    if (isOpen())
+        return true;
+
+      // Grouped, so all the counters cover exactly the same instructions
+    for (int e = 0; e < NUM_EVENTS; e++)
+    {
+        int fd = openCounter(EVENT_CONFIGS[e], m_groupFd);
+        if (fd < 0)
+            continue;
+        m_fds[e] = fd;
+        m_slot[e] = m_numOpen++;
+        if (m_groupFd < 0)
+            m_groupFd = fd;
+    }
+    if (!isOpen())
+        return false;
+
+    ioctl(m_groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(m_groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool HardwareCounters::read(Sample& sample) const
+{
+    memset(&sample, 0, sizeof(sample));
+#ifdef __linux__
+    if (!isOpen())
+        return false;
+
+      // A group read gives the number of counters, the time enabled and the
+      // time running, then each count
+    uint64_t values[3 + NUM_EVENTS];
+    if (::read(m_groupFd, values, sizeof(values)) < static_cast<ssize_t>((3 + m_numOpen) * sizeof(uint64_t)))
+        return false;
+    sample.timeEnabled = values[1];
+    sample.timeRunning = values[2];
+    for (int e = 0; e < NUM_EVENTS; e++)
+    {
+        if (m_slot[e] >= 0)
+            sample.counts[e] = values[3 + m_slot[e]];
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* HardwareCounters::eventName(int event)
+{
+    return EVENT_NAMES[event];
+}
+
+void CounterTally::reset()
+{
+    memset(&m_last, 0, sizeof(m_last));
+    memset(&m_total, 0, sizeof(m_total));
+    m_samples = 0;
+    m_skipped = 0;
+    m_lastSkipped = false;
+}
+
+void CounterTally::add(const HardwareCounters::Sample& before, const HardwareCounters::Sample& after)
+{
+    if (after.timeRunning - before.timeRunning < after.timeEnabled - before.timeEnabled)
+    {
+        m_skipped++;
+        m_lastSkipped = true;
+        return;
+    }
+    for (int e = 0; e < HardwareCounters::NUM_EVENTS; e++)
+    {
+        m_last.counts[e] = after.counts[e] - before.counts[e];
+        m_total.counts[e] += m_last.counts[e];
+    }
+    m_samples++;
+    m_lastSkipped = false;
+}
+
+void CounterTally::writeSummary(ostream& os, const char* name, const HardwareCounters& counters) const
+{
+    os << name << ": " << m_samples << " samples";
+    if (m_skipped > 0)
+        os << " (" << m_skipped << " more skipped, as the counters were shared)";
+    if (m_samples == 0)
+    {
+        os << "\n";
+        return;
+    }
+    for (int e = 0; e < HardwareCounters::NUM_EVENTS; e++)
+    {
+        if (counters.isSupported(e))
+            os << ", " << m_total.counts[e] / m_samples << " " << HardwareCounters::eventName(e);
+    }
+    os << " per sample";
+    if (counters.isSupported(HardwareCounters::CYCLES)  &&  counters.isSupported(HardwareCounters::INSTRUCTIONS)
+        &&  m_total.counts[HardwareCounters::CYCLES] > 0)
+    {
+        os << ", " << static_cast<double>(m_total.counts[HardwareCounters::INSTRUCTIONS]) /
+                      m_total.counts[HardwareCounters::CYCLES] << " instructions per cycle";
+    }
+    os << "\n";
+}
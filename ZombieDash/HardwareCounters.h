@@ -0,0 +1,114 @@
+#ifndef HARDWARECOUNTERS_H_
+#define HARDWARECOUNTERS_H_
+
+#include <ostream>
+
+  // The CPU's own counts of cycles, instructions, cache misses and branch
+  // misses for this process, read through perf_event_open.  Only Linux is
+  // supported; elsewhere, and where the kernel refuses access, open() fails
+  // and nothing is counted.  The counters run continuously once opened, so
+  // a stretch of code is measured by reading them before and after it.
+class HardwareCounters
+{
+  public:
+
+    enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, NUM_EVENTS };
+
+    struct Sample
+    {
+        unsigned long long counts[NUM_EVENTS];
+        unsigned long long timeEnabled;     // ns the group has been enabled
+        unsigned long long timeRunning;     // ns it actually had the hardware
+    };
+
+    HardwareCounters();
+    ~HardwareCounters();
+
+      // Returns false if none of the counters could be opened
+    bool open();
+
+    bool isOpen() const
+    {
+        return m_groupFd >= 0;
+    }
+
+      // Some machines, virtual ones especially, count only some events
+    bool isSupported(int event) const
+    {
+        return m_slot[event] >= 0;
+    }
+
+      // Counts since open(); unsupported events read as 0.  Returns false,
+      // leaving sample unusable, if the counters aren't open or can't be read.
+    bool read(Sample& sample) const;
+
+    static const char* eventName(int event);
+
+      // Prevent copying or assigning HardwareCounters
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+  private:
+
+    int     m_groupFd;              // the first counter opened, which leads the group
+    int     m_fds[NUM_EVENTS];
+    int     m_slot[NUM_EVENTS];     // position in a group read, or -1 if unsupported
+    int     m_numOpen;
+};
+
+  // Counts accumulated over many measured stretches, such as every tick of
+  // a level
+class CounterTally
+{
+  public:
+
+    CounterTally() { reset(); }
+
+    void reset();
+
+      // Add the counts between two reads of the counters.  If the kernel
+      // took the counters away for part of that time, to share them with
+      // other programs, the counts are short, so the stretch is skipped.
+    void add(const HardwareCounters::Sample& before, const HardwareCounters::Sample& after);
+
+      // Note a stretch that couldn't be read at all
+    void markUnread()
+    {
+        m_lastSkipped = true;
+    }
+
+      // The counts for the latest stretch that was measured
+    const HardwareCounters::Sample& last() const
+    {
+        return m_last;
+    }
+
+      // Was the latest stretch skipped or unread, so last() is older?
+    bool lastSkipped() const
+    {
+        return m_lastSkipped;
+    }
+
+    long samples() const
+    {
+        return m_samples;
+    }
+
+    long skipped() const
+    {
+        return m_skipped;
+    }
+
+      // One line of totals, and averages per stretch measured
+    void writeSummary(std::ostream& os, const char* name, const HardwareCounters& counters) const;
+
+  private:
+
+    HardwareCounters::Sample    m_last;
+    HardwareCounters::Sample    m_total;
+    long                        m_samples;
+    long                        m_skipped;      // stretches the counters didn't run for throughout
+    bool                        m_lastSkipped;
+};
+
+#endif // HARDWARECOUNTERS_H_
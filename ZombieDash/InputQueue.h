@@ -0,0 +1,87 @@
+#ifndef INPUTQUEUE_H_
+#define INPUTQUEUE_H_
+
+#include <atomic>
+#include <chrono>
+
+struct InputEvent
+{
+    int key;
+    std::chrono::steady_clock::time_point timeReceived;
+};
+
+  // Bounded ring of key presses, filled by the window system callbacks and
+  // emptied by the game.  There must be only one thread pushing and one
+  // popping; neither ever blocks or takes a lock.  When the ring is full,
+  // further keys are dropped and counted.
+class InputQueue
+{
+  public:
+
+    static const unsigned int CAPACITY = 64;   // must be a power of two
+
+    InputQueue()
+     : m_head(0), m_tail(0), m_dropped(0)
+    {
+    }
+
+      // Producer side
+    bool push(int key)
+    {
+        unsigned int tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_events[tail & (CAPACITY - 1)] = InputEvent{ key, std::chrono::steady_clock::now() };
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+      // Consumer side
+    bool pop(InputEvent& event)
+    {
+        unsigned int head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        event = m_events[head & (CAPACITY - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+      // Keys waiting to be popped; may be out of date as soon as it returns
+    unsigned int size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+      // Consumer side: throw away everything queued so far
+    void discardPending()
+    {
+        m_head.store(m_tail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    unsigned int droppedCount() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+      // Prevent copying or assigning InputQueues
+    InputQueue(const InputQueue&) = delete;
+    InputQueue& operator=(const InputQueue&) = delete;
+
+  private:
+
+    InputEvent                  m_events[CAPACITY];
+    std::atomic<unsigned int>   m_head;     // next event to pop
+    std::atomic<unsigned int>   m_tail;     // next free slot
+    std::atomic<unsigned int>   m_dropped;
+};
+
+#endif // INPUTQUEUE_H_
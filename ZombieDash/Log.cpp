@@ -0,0 +1,366 @@
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    using Clock = chrono::steady_clock;
+
+      // How long the writer thread sleeps when nothing urgent is logged
+    const chrono::milliseconds WRITE_INTERVAL(50);
+
+    const char* const LEVEL_NAMES[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+    struct LogSlot
+    {
+        Log::Level          level;
+        const char*         component;
+        Clock::time_point   time;
+        size_t              length;
+        char                text[LogRecord::MAX_TEXT];
+    };
+
+      // Records from one thread on their way to the writer thread.  Only the
+      // owning thread pushes, without locking, and records are only popped
+      // with the logger's lock held.
+    struct ThreadRing
+    {
+        static const unsigned int CAPACITY = 128;   // must be a power of two
+
+        LogSlot                 slots[CAPACITY];
+        atomic<unsigned int>    head{0};    // next record to write out
+        atomic<unsigned int>    tail{0};    // next free slot
+    };
+
+    enum LoggerState { NOT_STARTED, RUNNING, STOPPED };
+
+    class Logger
+    {
+      public:
+
+        Logger()
+         : m_state(NOT_STARTED), m_stopping(false), m_submitted(0), m_written(0), m_origin(Clock::now())
+        {
+        }
+
+        ~Logger()
+        {
+            stop();
+        }
+
+        void submit(Log::Level level, const char* component, const char* text, size_t length);
+        void flush();
+        void stop();
+
+      private:
+
+        mutex                   m_lock;         // never taken on the way to a ring, only to add one or to write
+        condition_variable      m_wake;
+        vector<unique_ptr<ThreadRing>> m_rings; // kept after their threads finish
+        thread                  m_writer;
+        atomic<int>             m_state;
+        bool                    m_stopping;     // guarded by m_lock
+        vector<LogSlot>         m_batch;        // guarded by m_lock
+        atomic<unsigned long>   m_submitted;    // records pushed into rings
+        atomic<unsigned long>   m_written;      // records the writer has written out
+        Clock::time_point       m_origin;
+
+        ThreadRing& threadRing();
+        void start();
+        void run();
+        void drain();
+        void write(const LogSlot* slots, size_t count);
+    };
+
+    Logger& logger()
+    {
+        static Logger l;
+        return l;
+    }
+}
+
+void Logger::submit(Log::Level level, const char* component, const char* text, size_t length)
+{
+    if (m_state.load(memory_order_acquire) == NOT_STARTED)
+        start();
+
+    ThreadRing* ring = &threadRing();
+    unsigned int tail = ring->tail.load(memory_order_relaxed);
+    while (tail - ring->head.load(memory_order_acquire) == ThreadRing::CAPACITY)
+    {
+          // Full, so the writer has fallen behind; give it a chance
+        if (m_state.load(memory_order_acquire) == STOPPED)
+            break;
+        m_wake.notify_one();
+        this_thread::yield();
+    }
+
+    LogSlot direct;
+    LogSlot* slot = &direct;
+    if (m_state.load(memory_order_acquire) == STOPPED)
+        ring = nullptr;
+    else
+        slot = &ring->slots[tail & (ThreadRing::CAPACITY - 1)];
+
+    slot->level = level;
+    slot->component = component;
+    slot->time = Clock::now();
+    slot->length = min(length, LogRecord::MAX_TEXT);
+    memcpy(slot->text, text, slot->length);
+
+    if (ring == nullptr)
+    {
+        lock_guard<mutex> guard(m_lock);
+        write(slot, 1);
+        return;
+    }
+
+    tail++;
+    ring->tail.store(tail, memory_order_seq_cst);
+    m_submitted.fetch_add(1, memory_order_relaxed);
+
+      // If stop() began after the check above, its last pass over the rings
+      // may have missed this record, so write it out here.  With both sides
+      // sequentially consistent, at least one of them sees the other.
+    if (m_state.load(memory_order_seq_cst) == STOPPED)
+    {
+        lock_guard<mutex> guard(m_lock);
+        drain();
+        return;
+    }
+
+    if (level >= Log::LEVEL_WARNING  ||  tail - ring->head.load(memory_order_relaxed) > ThreadRing::CAPACITY / 2)
+        m_wake.notify_one();
+}
+
+void Logger::flush()
+{
+    unsigned long target = m_submitted.load(memory_order_relaxed);
+    while (m_written.load(memory_order_acquire) < target  &&  m_state.load(memory_order_acquire) == RUNNING)
+    {
+        m_wake.notify_one();
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+  // Anything logged from now on is written by the thread that logs it
+void Logger::stop()
+{
+    unique_lock<mutex> guard(m_lock);
+    bool wasRunning = (m_state.load(memory_order_relaxed) == RUNNING);
+    m_state.store(STOPPED, memory_order_seq_cst);
+    if (!wasRunning)
+        return;
+    m_stopping = true;
+    guard.unlock();
+    m_wake.notify_one();
+    m_writer.join();
+
+      // Records pushed by threads that got past submit()'s check before the
+      // state changed may have missed the writer's last pass
+    guard.lock();
+    drain();
+}
+
+ThreadRing& Logger::threadRing()
+{
+    thread_local ThreadRing* ring = nullptr;
+    if (ring == nullptr)
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_rings.emplace_back(new ThreadRing);
+        ring = m_rings.back().get();
+    }
+    return *ring;
+}
+
+void Logger::start()
+{
+    lock_guard<mutex> guard(m_lock);
+    if (m_state.load(memory_order_relaxed) != NOT_STARTED)
+        return;
+    m_writer = thread(&Logger::run, this);
+    m_state.store(RUNNING, memory_order_release);
+}
+
+  // The writer thread
+void Logger::run()
+{
+    unique_lock<mutex> guard(m_lock);
+    for (;;)
+    {
+        bool stopping = m_stopping;
+        drain();
+        if (stopping)
+            break;
+        m_wake.wait_for(guard, WRITE_INTERVAL);
+    }
+}
+
+  // Called with m_lock held.  Takes everything waiting in every ring and
+  // writes it out in the order it was logged.
+void Logger::drain()
+{
+    m_batch.clear();
+    for (auto& ring : m_rings)
+    {
+        unsigned int head = ring->head.load(memory_order_relaxed);
+        unsigned int tail = ring->tail.load(memory_order_seq_cst);    // pairs with submit() during stop()
+        for ( ; head != tail; head++)
+            m_batch.push_back(ring->slots[head & (ThreadRing::CAPACITY - 1)]);
+        ring->head.store(head, memory_order_release);
+    }
+    if (m_batch.empty())
+        return;
+    stable_sort(m_batch.begin(), m_batch.end(),
+                [](const LogSlot& a, const LogSlot& b) { return a.time < b.time; });
+    write(m_batch.data(), m_batch.size());
+    m_written.fetch_add(m_batch.size(), memory_order_release);
+}
+
+  // Called with m_lock held
+void Logger::write(const LogSlot* slots, size_t count)
+{
+    char line[LogRecord::MAX_TEXT + 64];
+    for (size_t i = 0; i < count; i++)
+    {
+        const LogSlot& s = slots[i];
+        double seconds = chrono::duration<double>(s.time - m_origin).count();
+        int n = snprintf(line, sizeof(line), "[%9.3f] %-7s %s: %.*s\n", seconds,
+                         LEVEL_NAMES[s.level], s.component, static_cast<int>(s.length), s.text);
+        fwrite(line, 1, min(static_cast<size_t>(n), sizeof(line) - 1), stderr);
+    }
+    fflush(stderr);
+}
+
+bool Log::parseLevel(const string& name, Level& level)
+{
+    static const struct { const char* name; Level level; } levels[] = {
+        { "debug", LEVEL_DEBUG }, { "info", LEVEL_INFO }, { "warning", LEVEL_WARNING }, { "error", LEVEL_ERROR }
+    };
+    for (const auto& l : levels)
+    {
+        if (name == l.name)
+        {
+            level = l.level;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Log::writeLines(Level level, const char* component, const string& text)
+{
+    if (!isEnabled(level))
+        return;
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t end = text.find('\n', start);
+        if (end == string::npos)
+            end = text.size();
+        if (end > start)
+            submit(level, component, text.data() + start, end - start);
+        start = end + 1;
+    }
+}
+
+void Log::flush()
+{
+    logger().flush();
+}
+
+void Log::shutdown()
+{
+    logger().stop();
+}
+
+void Log::submit(Level level, const char* component, const char* text, size_t length)
+{
+    logger().submit(level, component, text, length);
+}
+
+LogRecord::LogRecord(Log::Level level, const char* component, const char* message)
+ : m_level(level), m_component(component), m_length(0)
+{
+    append("%s", message);
+}
+
+LogRecord::LogRecord(Log::Level level, const char* component, const string& message)
+ : LogRecord(level, component, message.c_str())
+{
+}
+
+LogRecord& LogRecord::field(const char* key, int value)
+{
+    append(" %s=%d", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, unsigned int value)
+{
+    append(" %s=%u", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, long value)
+{
+    append(" %s=%ld", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, unsigned long value)
+{
+    append(" %s=%lu", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, long long value)
+{
+    append(" %s=%lld", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, unsigned long long value)
+{
+    append(" %s=%llu", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, double value)
+{
+    append(" %s=%g", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, const char* value)
+{
+    append(" %s=\"%s\"", key, value);
+    return *this;
+}
+
+LogRecord& LogRecord::field(const char* key, const string& value)
+{
+    return field(key, value.c_str());
+}
+
+void LogRecord::append(const char* format, ...)
+{
+    if (m_length >= MAX_TEXT - 1)
+        return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(m_text + m_length, MAX_TEXT - m_length, format, args);
+    va_end(args);
+    if (n > 0)
+        m_length = min(m_length + n, MAX_TEXT - 1);
+}
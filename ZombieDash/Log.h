@@ -0,0 +1,116 @@
+#ifndef LOG_H_
+#define LOG_H_
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+  // Diagnostics for the console.  Each thread copies its records into a ring
+  // of its own without locking, and a background thread formats them and
+  // writes them to standard error, so logging never waits on the terminal.
+  // Records below the minimum level are skipped before their fields are
+  // even evaluated, and LOG_DEBUG records are compiled out altogether when
+  // NDEBUG is defined.
+class Log
+{
+  public:
+
+    enum Level { LEVEL_DEBUG, LEVEL_INFO, LEVEL_WARNING, LEVEL_ERROR };
+
+    static bool isEnabled(Level level)
+    {
+        return level >= minimumLevel().load(std::memory_order_relaxed);
+    }
+
+    static void setMinimumLevel(Level level)
+    {
+        minimumLevel().store(level, std::memory_order_relaxed);
+    }
+
+      // Accepts debug, info, warning or error
+    static bool parseLevel(const std::string& name, Level& level);
+
+      // Log each line of text as a record of its own, for multi-line reports
+    static void writeLines(Level level, const char* component, const std::string& text);
+
+      // Wait until everything logged so far has been written
+    static void flush();
+
+      // Flush, then stop the background thread.  Anything logged afterwards
+      // is written straight away by the thread that logs it.
+    static void shutdown();
+
+      // component must be a string literal, or otherwise outlive the logger
+    static void submit(Level level, const char* component, const char* text, std::size_t length);
+
+  private:
+
+    static std::atomic<int>& minimumLevel()
+    {
+        static std::atomic<int> level(LEVEL_INFO);
+        return level;
+    }
+};
+
+  // One record being built.  It goes to the logger when it is destroyed at
+  // the end of the statement that made it, with its fields appended to the
+  // message as key=value pairs.
+class LogRecord
+{
+  public:
+
+    static constexpr std::size_t MAX_TEXT = 480;    // longer records are cut short
+
+    LogRecord(Log::Level level, const char* component, const char* message);
+    LogRecord(Log::Level level, const char* component, const std::string& message);
+
+    ~LogRecord()
+    {
+        Log::submit(m_level, m_component, m_text, m_length);
+    }
+
+    LogRecord& field(const char* key, int value);
+    LogRecord& field(const char* key, unsigned int value);
+    LogRecord& field(const char* key, long value);
+    LogRecord& field(const char* key, unsigned long value);
+    LogRecord& field(const char* key, long long value);
+    LogRecord& field(const char* key, unsigned long long value);
+    LogRecord& field(const char* key, double value);
+    LogRecord& field(const char* key, const char* value);
+    LogRecord& field(const char* key, const std::string& value);
+
+      // Prevent copying or assigning LogRecords
+    LogRecord(const LogRecord&) = delete;
+    LogRecord& operator=(const LogRecord&) = delete;
+
+  private:
+
+    Log::Level  m_level;
+    const char* m_component;
+    char        m_text[MAX_TEXT];
+    std::size_t m_length;
+
+    void append(const char* format, ...);
+};
+
+  // Lets the macros below be a single expression, so they are safe inside an
+  // unbraced if
+struct LogVoidify
+{
+    void operator&(const LogRecord&) {}
+};
+
+  // e.g. LOG_INFO("level", "Loaded level").field("level", 3);
+#define LOG_AT(level, component, message) \
+    !Log::isEnabled(level) ? (void)0 : LogVoidify() & LogRecord(level, component, message)
+#define LOG_INFO(component, message)    LOG_AT(Log::LEVEL_INFO, component, message)
+#define LOG_WARNING(component, message) LOG_AT(Log::LEVEL_WARNING, component, message)
+#define LOG_ERROR(component, message)   LOG_AT(Log::LEVEL_ERROR, component, message)
+#ifdef NDEBUG
+#define LOG_DEBUG(component, message) \
+    true ? (void)0 : LogVoidify() & LogRecord(Log::LEVEL_DEBUG, component, message)
+#else
+#define LOG_DEBUG(component, message)   LOG_AT(Log::LEVEL_DEBUG, component, message)
+#endif
+
+#endif // LOG_H_
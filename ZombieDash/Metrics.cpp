@@ -0,0 +1,198 @@
+#include "Metrics.h"
+#include <sstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Ws2_32.lib")
+#endif
+using SocketHandle = SOCKET;
+static const SocketHandle NO_SOCKET = INVALID_SOCKET;
+static void closeSocket(SocketHandle s) { closesocket(s); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketHandle = int;
+static const SocketHandle NO_SOCKET = -1;
+static void closeSocket(SocketHandle s) { close(s); }
+#endif
+
+using namespace std;
+
+  // How long the server waits for a connection before checking whether it
+  // should stop, and how long it waits for a request once connected
+static const int POLL_MS = 200;
+
+  // A scraper hanging up early must not kill the game with SIGPIPE
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+  // Wait until s can be read from, for at most ms milliseconds
+static bool waitForInput(SocketHandle s, int ms)
+{
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(s, &readable);
+    timeval timeout = { 0, ms * 1000 };
+    return select(static_cast<int>(s) + 1, &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+MetricsRegistry::MetricsRegistry()
+ : m_count(0), m_listener(static_cast<intptr_t>(NO_SOCKET)), m_stopping(false)
+{
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    stopServer();
+}
+
+bool MetricsRegistry::startServer(int port)
+{
+    if (isServing())
+        return true;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return false;
+#endif
+
+    SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == NO_SOCKET)
+        return false;
+
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+      // Only reachable from this machine
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<unsigned short>(port));
+    if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0  ||
+        listen(listener, 4) != 0)
+    {
+        closeSocket(listener);
+        return false;
+    }
+
+    m_listener = static_cast<intptr_t>(listener);
+    m_stopping = false;
+    m_server = thread(&MetricsRegistry::serve, this);
+    return true;
+}
+
+void MetricsRegistry::stopServer()
+{
+    if (!isServing())
+        return;
+    m_stopping = true;
+    m_server.join();
+    closeSocket(static_cast<SocketHandle>(m_listener));
+    m_listener = static_cast<intptr_t>(NO_SOCKET);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+Metric& MetricsRegistry::gauge(const string& name, const string& help, const string& labels)
+{
+    return findOrAdd(name, help, "gauge", labels);
+}
+
+Metric& MetricsRegistry::counter(const string& name, const string& help, const string& labels)
+{
+    return findOrAdd(name, help, "counter", labels);
+}
+
+Metric& MetricsRegistry::summary(const string& name, const string& help, const string& labels)
+{
+    return findOrAdd(name, help, "summary", labels);
+}
+
+Metric& MetricsRegistry::findOrAdd(const string& name, const string& help, const char* type, const string& labels)
+{
+    int count = m_count.load(memory_order_relaxed);
+    for (int i = 0; i < count; i++)
+    {
+        if (m_metrics[i].m_name == name  &&  m_metrics[i].m_labels == labels)
+            return m_metrics[i];
+    }
+    if (count == MAX_METRICS)
+        return m_overflow;
+
+      // Fill the slot in before the server can see it
+    Metric& m = m_metrics[count];
+    m.m_name = name;
+    m.m_help = help;
+    m.m_type = type;
+    m.m_labels = labels;
+    m_count.store(count + 1, memory_order_release);
+    return m;
+}
+
+void MetricsRegistry::writeText(ostream& os) const
+{
+    streamsize oldPrecision = os.precision(15);    // so large counters aren't rounded
+    int count = m_count.load(memory_order_acquire);
+    for (int i = 0; i < count; i++)
+    {
+        const Metric& m = m_metrics[i];
+        if (!m.m_help.empty()  &&  (i == 0  ||  m_metrics[i-1].m_name != m.m_name))
+        {
+            os << "# HELP " << m.m_name << " " << m.m_help << "\n"
+               << "# TYPE " << m.m_name << " " << m.m_type << "\n";
+        }
+        os << m.m_name;
+        if (!m.m_labels.empty())
+            os << "{" << m.m_labels << "}";
+        os << " " << m.value() << "\n";
+    }
+    os.precision(oldPrecision);
+}
+
+  // Runs on the server thread.  Every request gets the metrics, whatever
+  // path it asks for.
+void MetricsRegistry::serve()
+{
+    SocketHandle listener = static_cast<SocketHandle>(m_listener);
+    while (!m_stopping)
+    {
+        if (!waitForInput(listener, POLL_MS))
+            continue;
+        SocketHandle client = accept(listener, nullptr, nullptr);
+        if (client == NO_SOCKET)
+            continue;
+
+        char request[1024];
+        if (waitForInput(client, POLL_MS)  &&  recv(client, request, sizeof(request), 0) > 0)
+        {
+            ostringstream body;
+            writeText(body);
+            string text = body.str();
+            ostringstream response;
+            response << "HTTP/1.0 200 OK\r\n"
+                     << "Content-Type: text/plain; version=0.0.4\r\n"
+                     << "Content-Length: " << text.size() << "\r\n"
+                     << "Connection: close\r\n\r\n"
+                     << text;
+            string out = response.str();
+            for (size_t sent = 0; sent < out.size(); )
+            {
+                int n = send(client, out.data() + sent, static_cast<int>(out.size() - sent), SEND_FLAGS);
+                if (n <= 0)
+                    break;
+                sent += n;
+            }
+        }
+        closeSocket(client);
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+
+  // One time series.  Only one thread may change a given metric, but any
+  // thread may read it at any time without locking.
+class Metric
+{
+  public:
+
+    Metric()
+     : m_type(""), m_value(0)
+    {
+    }
+
+    void set(double value)
+    {
+        m_value.store(value, std::memory_order_relaxed);
+    }
+
+    void add(double amount)
+    {
+        m_value.store(m_value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    double value() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+      // Prevent copying or assigning Metrics
+    Metric(const Metric&) = delete;
+    Metric& operator=(const Metric&) = delete;
+
+  private:
+
+    friend class MetricsRegistry;
+
+    std::string         m_name;
+    std::string         m_help;     // empty for the _sum and _count series of a summary
+    const char*         m_type;
+    std::string         m_labels;   // in Prometheus syntax, e.g. kind="Wall"
+    std::atomic<double> m_value;
+};
+
+  // Metrics in the Prometheus text format, served over HTTP on the loopback
+  // interface by a background thread.  Metrics are only added by the game
+  // thread, and once added are never moved or removed, so the server reads
+  // them without ever holding up a tick.
+class MetricsRegistry
+{
+  public:
+
+    static const int MAX_METRICS = 128;
+
+    MetricsRegistry();
+    ~MetricsRegistry();
+
+      // Returns false if the port can't be listened on
+    bool startServer(int port);
+    void stopServer();
+
+    bool isServing() const
+    {
+        return m_server.joinable();
+    }
+
+      // The metric with this name and labels, added if there isn't one yet.
+      // The series of one metric must be added one after another, and only
+      // the first needs help text.
+    Metric& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+    Metric& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    Metric& summary(const std::string& name, const std::string& help, const std::string& labels = "");
+
+    void writeText(std::ostream& os) const;
+
+      // Prevent copying or assigning MetricsRegistries
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+  private:
+
+    Metric              m_metrics[MAX_METRICS];
+    std::atomic<int>    m_count;        // metrics added so far
+    Metric              m_overflow;     // handed out once m_metrics is full, and never served
+    std::thread         m_server;
+    std::intptr_t       m_listener;     // the listening socket
+    std::atomic<bool>   m_stopping;
+
+    Metric& findOrAdd(const std::string& name, const std::string& help, const char* type, const std::string& labels);
+    void serve();
+};
+
+  // Meyers singleton pattern
+inline MetricsRegistry& Metrics()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+#endif // METRICS_H_
@@ -0,0 +1,117 @@
+#ifndef PERFSTATS_H_
+#define PERFSTATS_H_
+
+#include <algorithm>
+#include <ostream>
+
+  // Timings for one stage of the game loop, in milliseconds.  The most recent
+  // samples are kept for a rolling view, and every sample is also counted in
+  // a histogram so the whole run can be summarised at the end.
+class PerfMetric
+{
+  public:
+
+    static const int WINDOW = 240;          // samples in the rolling view
+    static const int NUM_BUCKETS = 500;     // the last bucket also holds everything slower
+    static constexpr double BUCKET_MS = 0.1;
+
+    PerfMetric()
+     : m_recentCount(0), m_next(0), m_count(0), m_total(0), m_max(0), m_buckets()
+    {
+    }
+
+    void addSample(double ms)
+    {
+        m_recent[m_next] = ms;
+        m_next = (m_next + 1) % WINDOW;
+        if (m_recentCount < WINDOW)
+            m_recentCount++;
+
+        int bucket = static_cast<int>(ms / BUCKET_MS);
+        m_buckets[std::max(0, std::min(bucket, NUM_BUCKETS - 1))]++;
+        m_count++;
+        m_total += ms;
+        m_max = std::max(m_max, ms);
+    }
+
+    int recentCount() const
+    {
+        return m_recentCount;
+    }
+
+      // age 0 is the newest sample
+    double recentSample(int age) const
+    {
+        return m_recent[(m_next - 1 - age + 2 * WINDOW) % WINDOW];
+    }
+
+    double last() const
+    {
+        return m_recentCount == 0 ? 0 : recentSample(0);
+    }
+
+      // fraction is between 0 and 1, e.g. .99 for the 99th percentile
+    double recentPercentile(double fraction) const
+    {
+        if (m_recentCount == 0)
+            return 0;
+        double sorted[WINDOW];
+        std::copy(m_recent, m_recent + m_recentCount, sorted);
+        int index = std::min(m_recentCount - 1, static_cast<int>(fraction * m_recentCount));
+        std::nth_element(sorted, sorted + index, sorted + m_recentCount);
+        return sorted[index];
+    }
+
+    double recentMax() const
+    {
+        return m_recentCount == 0 ? 0 : *std::max_element(m_recent, m_recent + m_recentCount);
+    }
+
+    long count() const
+    {
+        return m_count;
+    }
+
+    double total() const
+    {
+        return m_total;
+    }
+
+      // Over the whole run, to the resolution of the histogram
+    double percentile(double fraction) const
+    {
+        long target = static_cast<long>(fraction * m_count);
+        long seen = 0;
+        for (int b = 0; b < NUM_BUCKETS - 1; b++)
+        {
+            seen += m_buckets[b];
+            if (seen > target)
+                return (b + 1) * BUCKET_MS;
+        }
+        return m_max;
+    }
+
+    void writeSummary(std::ostream& os, const char* name) const
+    {
+        os << name << ": " << m_count << " samples, mean "
+           << (m_count == 0 ? 0 : m_total / m_count) << " ms, p50 " << percentile(.5)
+           << " ms, p99 " << percentile(.99) << " ms, max " << m_max << " ms\n";
+        for (int b = 0; b < NUM_BUCKETS; b++)
+        {
+            if (m_buckets[b] != 0)
+                os << "  " << b * BUCKET_MS << (b == NUM_BUCKETS - 1 ? "+" : "") << " ms\t" << m_buckets[b] << "\n";
+        }
+    }
+
+  private:
+
+    double  m_recent[WINDOW];
+    int     m_recentCount;
+    int     m_next;         // where the next sample goes in m_recent
+    long    m_count;
+    double  m_total;
+    double  m_max;
+    long    m_buckets[NUM_BUCKETS];
+};
+
+#endif // PERFSTATS_H_
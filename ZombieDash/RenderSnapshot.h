@@ -0,0 +1,86 @@
+#ifndef RENDERSNAPSHOT_H_
+#define RENDERSNAPSHOT_H_
+
+#include <atomic>
+#include <vector>
+
+  // Everything needed to draw one object, copied out of its GraphObject at
+  // the end of a tick so that drawing never touches live game objects
+struct SpriteRecord
+{
+    int     imageID;
+    int     animationNumber;
+    double  x;
+    double  y;
+    double  prevX;          // where it was before moving this tick
+    double  prevY;
+    int     direction;
+    int     depth;
+    double  size;
+    bool    movedThisTick;
+};
+
+struct RenderSnapshot
+{
+    std::vector<SpriteRecord>   staticSprites;  // walls, pits and exits
+    std::vector<SpriteRecord>   sprites;        // everything else, in drawing order
+    unsigned int                staticLayerVersion = 0;
+};
+
+  // Hands snapshots from the simulation to the renderer without locking.
+  // The producer fills back() and publishes it, and the consumer picks up
+  // the newest published snapshot with acquire().  Each side owns one of
+  // the three buffers outright and the third is exchanged atomically, so
+  // neither side ever sees a buffer the other is still using.
+class SnapshotBuffer
+{
+  public:
+
+    SnapshotBuffer()
+     : m_back(0), m_middle(1), m_front(2), m_hasFront(false)
+    {
+    }
+
+      // The buffer the producer may fill
+    RenderSnapshot& back()
+    {
+        return m_buffers[m_back];
+    }
+
+      // Make the filled back buffer available to the consumer
+    void publish()
+    {
+        int old = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+        m_back = old & INDEX_MASK;
+    }
+
+      // The newest published snapshot, which stays valid until the next call,
+      // or nullptr if nothing has been published yet
+    const RenderSnapshot* acquire()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & FRESH)
+        {
+            int old = m_middle.exchange(m_front, std::memory_order_acq_rel);
+            m_front = old & INDEX_MASK;
+            m_hasFront = true;
+        }
+        return m_hasFront ? &m_buffers[m_front] : nullptr;
+    }
+
+      // Prevent copying or assigning SnapshotBuffers
+    SnapshotBuffer(const SnapshotBuffer&) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+  private:
+
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4;     // set while the middle buffer is unread
+
+    RenderSnapshot      m_buffers[3];
+    int                 m_back;     // producer only
+    std::atomic<int>    m_middle;
+    int                 m_front;    // consumer only
+    bool                m_hasFront;
+};
+
+#endif // RENDERSNAPSHOT_H_
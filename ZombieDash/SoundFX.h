@@ -7,7 +7,7 @@
 
 #include "irrKlang/irrKlang.h"
 #pragma comment(lib, "irrKlang.lib")
-#include <iostream>
+#include "Log.h"
 
 class SoundFXController
 {
@@ -34,8 +34,7 @@ class SoundFXController
     {
         m_engine = irrklang::createIrrKlangDevice();
         if (m_engine == nullptr)
-            std::cout << "Cannot create sound engine!  Game will be silent."
-                      << std::endl;
+            LOG_WARNING("sound", "Cannot create sound engine!  Game will be silent.");
     }
 
     ~SoundFXController()
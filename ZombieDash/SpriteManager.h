@@ -11,12 +11,18 @@
 #define GL_BGRA GL_BGRA_EXT
 #endif
 
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
 #include "GameConstants.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <map>
+#include <vector>
 #include <memory>
+#include <algorithm>
 #include <cmath>
 
 static const double VISIBLE_MIN_X = -2.39;
@@ -35,6 +41,8 @@ public:
     {
     }
 
+      // Read a sprite frame from a TGA file.  Frames are kept in memory until
+      // buildAtlas() packs them all into one texture.
     bool loadSprite(std::string filename_tga, int imageID, int frameNum)
     {
           // Load Texture Data From TGA File
@@ -43,7 +51,10 @@ public:
         if (spriteID == INVALID_SPRITE_ID)
             return false;
 
-        m_frameCountPerSprite[imageID]++;   // keep track of how many frames per sprite we loaded
+          // keep track of how many frames per sprite we loaded
+        if (imageID >= static_cast<int>(m_frameCounts.size()))
+            m_frameCounts.resize(imageID + 1, 0);
+        m_frameCounts[imageID]++;
 
         std::ifstream tgaFile(filename_tga, std::ios::in|std::ios::binary);
         if (!tgaFile)
@@ -74,16 +85,114 @@ public:
         if (byteCount != 3 && byteCount != 4)
             return false;
 
+          // byteCount of 3 means that BGR data is being supplied. byteCount of 4 means that BGRA data is being supplied.
+          // Widen everything to BGRA so all frames can share one texture.
+        SpriteImage& image = m_images[spriteID];
+        image.width = textureWidth;
+        image.height = textureHeight;
+        image.pixels.resize(4 * textureWidth * textureHeight);
+        for (unsigned int i = 0; i < textureWidth * textureHeight; i++)
+        {
+            const char* src = imageData.get() + i * byteCount;
+            unsigned char* dst = &image.pixels[4 * i];
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            dst[3] = (byteCount == 4 ? src[3] : 255);
+        }
+
+        return true;
+    }
+
+      // Pack every loaded frame into a single texture and record where each
+      // one landed, so a whole frame's sprites can be drawn without rebinding
+    bool buildAtlas()
+    {
+          // Shelf packing: tallest frames first, left to right in rows
+        std::vector<int> order;
+        for (const auto& entry : m_images)
+            order.push_back(entry.first);
+        std::sort(order.begin(), order.end(),
+            [this](int a, int b) { return m_images[a].height > m_images[b].height; });
+
+        std::map<int, std::pair<int, int>> origins;
+        int shelfX = 0, shelfY = 0, shelfHeight = 0;
+        for (int spriteID : order)
+        {
+            const SpriteImage& image = m_images[spriteID];
+            int paddedWidth = image.width + 2 * ATLAS_PADDING;
+            int paddedHeight = image.height + 2 * ATLAS_PADDING;
+            if (paddedWidth > ATLAS_WIDTH)
+                return false;
+            if (shelfX + paddedWidth > ATLAS_WIDTH)
+            {
+                shelfY += shelfHeight;
+                shelfX = 0;
+                shelfHeight = 0;
+            }
+            origins[spriteID] = std::make_pair(shelfX + ATLAS_PADDING, shelfY + ATLAS_PADDING);
+            shelfX += paddedWidth;
+            shelfHeight = std::max(shelfHeight, paddedHeight);
+        }
+
+        int atlasHeight = 1;
+        while (atlasHeight < shelfY + shelfHeight)
+            atlasHeight *= 2;
+
+        GLint maxTextureSize;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        if (atlasHeight > maxTextureSize  ||  ATLAS_WIDTH > maxTextureSize)
+            return false;
+
+          // Size the lookup table from the frames actually loaded, since image
+          // IDs and frame numbers are small, dense integers
+        m_numImages = 0;
+        m_framesPerImage = 0;
+        for (const auto& entry : m_images)
+        {
+            m_numImages = std::max(m_numImages, entry.first / MAX_FRAMES_PER_SPRITE + 1);
+            m_framesPerImage = std::max(m_framesPerImage, entry.first % MAX_FRAMES_PER_SPRITE + 1);
+        }
+        m_regions.assign(m_numImages * m_framesPerImage, AtlasRegion());
+
+          // Copy each frame in, smearing its edge pixels out into the padding
+          // so filtering and smaller mipmaps don't pick up the neighbours
+        std::vector<unsigned char> atlas(4 * ATLAS_WIDTH * atlasHeight, 0);
+        for (const auto& entry : origins)
+        {
+            const SpriteImage& image = m_images[entry.first];
+            int originX = entry.second.first;
+            int originY = entry.second.second;
+            for (int y = -ATLAS_PADDING; y < image.height + ATLAS_PADDING; y++)
+            {
+                int srcY = std::min(std::max(y, 0), image.height - 1);
+                for (int x = -ATLAS_PADDING; x < image.width + ATLAS_PADDING; x++)
+                {
+                    int srcX = std::min(std::max(x, 0), image.width - 1);
+                    const unsigned char* src = &image.pixels[4 * (srcY * image.width + srcX)];
+                    unsigned char* dst = &atlas[4 * ((originY + y) * ATLAS_WIDTH + originX + x)];
+                    std::copy(src, src + 4, dst);
+                }
+            }
+
+            AtlasRegion& region = m_regions[(entry.first / MAX_FRAMES_PER_SPRITE) * m_framesPerImage + entry.first % MAX_FRAMES_PER_SPRITE];
+            region.loaded = true;
+            region.u0 = static_cast<GLfloat>(originX) / ATLAS_WIDTH;
+            region.v0 = static_cast<GLfloat>(originY) / atlasHeight;
+            region.u1 = static_cast<GLfloat>(originX + image.width) / ATLAS_WIDTH;
+            region.v1 = static_cast<GLfloat>(originY + image.height) / atlasHeight;
+        }
+        m_images.clear();
+
           // Transfer Texture To OpenGL
 
         glEnable(GL_DEPTH_TEST);
 
           // allocate a texture handle
-        GLuint glTextureID;
-        glGenTextures(1, &glTextureID);
+        glGenTextures(1, &m_atlasTexture);
 
           // bind our new texture
-        glBindTexture(GL_TEXTURE_2D, glTextureID);
+        glBindTexture(GL_TEXTURE_2D, m_atlasTexture);
 
         glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
@@ -100,120 +209,171 @@ public:
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         }
 
-          // Have the texture wrap both vertically and horizontally.
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLfloat>(GL_REPEAT));
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLfloat>(GL_REPEAT));
+          // Frames sit side by side, so clamp rather than wrap at the atlas edges
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, static_cast<GLfloat>(GL_CLAMP_TO_EDGE));
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, static_cast<GLfloat>(GL_CLAMP_TO_EDGE));
 
         if (m_mipMapped)
         {
               // build our texture mipmaps
-              // byteCount of 3 means that BGR data is being supplied. byteCount of 4 means that BGRA data is being supplied.
-            makeMipmaps(byteCount, textureWidth, textureHeight, imageData.get());
+            makeMipmaps(4, ATLAS_WIDTH, atlasHeight, reinterpret_cast<char*>(atlas.data()));
         }
         else
         {
-              // byteCount of 3 means that BGR data is being supplied. byteCount of 4 means that BGRA data is being supplied.
-            if (3 == byteCount)
-                glTexImage2D(GL_TEXTURE_2D, 0, 3, textureWidth, textureHeight, 0, GL_BGR, GL_UNSIGNED_BYTE, imageData.get());
-            else if (4 == byteCount)
-                glTexImage2D(GL_TEXTURE_2D, 0, 4, textureWidth, textureHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, imageData.get());
+            glTexImage2D(GL_TEXTURE_2D, 0, 4, ATLAS_WIDTH, atlasHeight, 0, GL_BGRA, GL_UNSIGNED_BYTE, atlas.data());
         }
 
-        m_imageMap[spriteID] = glTextureID;
-
         return true;
     }
 
     int getNumFrames(int imageID) const
     {
-        auto it = m_frameCountPerSprite.find(imageID);
-        if (it == m_frameCountPerSprite.end())
+        if (imageID < 0  ||  imageID >= static_cast<int>(m_frameCounts.size()))
             return 0;
 
-        return it->second;
+        return m_frameCounts[imageID];
     }
 
+      // Queue a sprite for the current batch.  Sprites are drawn by
+      // flushBatch() in the order they were queued.
     bool plotSprite(int imageID, int frame, double x, double y, int angleDegrees, double size)
     {
-        int spriteID = getSpriteID(imageID, frame);
-        if (spriteID == INVALID_SPRITE_ID)
+        if (imageID < 0  ||  imageID >= m_numImages  ||  frame < 0  ||  frame >= m_framesPerImage)
             return false;
 
-        auto it = m_imageMap.find(spriteID);
-        if (it == m_imageMap.end())
+        const AtlasRegion& region = m_regions[imageID * m_framesPerImage + frame];
+        if (!region.loaded)
             return false;
 
-        glPushMatrix();
-
-        double finalWidth = SPRITE_WIDTH_GL * size;
-        double finalHeight = SPRITE_HEIGHT_GL * size;
+        m_vertices.resize(m_vertices.size() + 4);
+        BatchVertex* vertices = &m_vertices[m_vertices.size() - 4];
 
-        // object's x/y location is center-based, but sprite plotting is upper-left-corner based
-        const double xoffset = 0;// finalWidth / 2;
-        const double yoffset = 0;// finalHeight / 2;
+        double halfWidth = SPRITE_WIDTH_GL * size / 2;
+        double halfHeight = SPRITE_HEIGHT_GL * size / 2;
 
         double gx, gy, gz;
         convertToGlutCoords(x, y, gx, gy, gz);
-        glTranslatef(static_cast<GLfloat>(gx-xoffset),static_cast<GLfloat>(gy-yoffset),static_cast<GLfloat>(gz));
-        glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        const GLfloat texCoords[4][2] = {
+            { region.u0, region.v0 }, { region.u1, region.v0 }, { region.u1, region.v1 }, { region.u0, region.v1 }
+        };
+        double corners[4][2];
+        orientedCorners(angleDegrees, halfWidth, halfHeight, corners);
+        for (int k = 0; k < 4; k++)
+        {
+            vertices[k].x = static_cast<GLfloat>(gx + corners[k][0]);
+            vertices[k].y = static_cast<GLfloat>(gy + corners[k][1]);
+            vertices[k].z = static_cast<GLfloat>(gz);
+            vertices[k].u = texCoords[k][0];
+            vertices[k].v = texCoords[k][1];
+        }
+
+        return true;
+    }
+
+      // Start a new frame's batch
+    void beginBatch()
+    {
+        m_vertices.clear();
+    }
+
+      // Draw everything queued since beginBatch() with one vertex array and,
+      // as every frame lives in the atlas, a single draw call
+    void flushBatch()
+    {
+        if (m_vertices.empty())
+            return;
+
+        glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_ENABLE_BIT);
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
         glEnable(GL_TEXTURE_2D);
         glDisable(GL_DEPTH_TEST);
-        glEnable (GL_BLEND);
+        glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glBindTexture(GL_TEXTURE_2D, it->second);
-
+        glBindTexture(GL_TEXTURE_2D, m_atlasTexture);
         glColor3f(1.0, 1.0, 1.0);
 
-        double cx1 = 0, cy1 = 0;
-        double cx2 = 1, cy2 = 0;
-        double cx3 = 1, cy3 = 1;
-        double cx4 = 0, cy4 = 1;
-
-          // Rotate sprite.  For 180 degrees, don't rotate, but reflect
-        double rx1, ry1, rx2, ry2, rx3, ry3, rx4, ry4;
-        double rotationAngle = (angleDegrees == 180 ? 0 : angleDegrees);
-        rotate(-finalWidth / 2, -finalHeight / 2, rotationAngle, rx1, ry1);
-        rotate( finalWidth / 2, -finalHeight / 2, rotationAngle, rx2, ry2);
-        rotate( finalWidth / 2,  finalHeight / 2, rotationAngle, rx3, ry3);
-        rotate(-finalWidth / 2,  finalHeight / 2, rotationAngle, rx4, ry4);
-        if (angleDegrees == 180)
-        {
-            // No rotation happened, but reflect to face left
-            std::swap(rx1, rx2);
-            std::swap(rx3, rx4);
-        }
-
-        glBegin(GL_QUADS);
-        glTexCoord2d(cx1, cy1);
-        glVertex3f(static_cast<GLfloat>(rx1), static_cast<GLfloat>(ry1), 0);
-        glTexCoord2d(cx2, cy2);
-        glVertex3f(static_cast<GLfloat>(rx2), static_cast<GLfloat>(ry2), 0);
-        glTexCoord2d(cx3, cy3);
-        glVertex3f(static_cast<GLfloat>(rx3), static_cast<GLfloat>(ry3), 0);
-        glTexCoord2d(cx4, cy4);
-        glVertex3f(static_cast<GLfloat>(rx4), static_cast<GLfloat>(ry4), 0);
-        glEnd();
-
-        glDisable(GL_TEXTURE_2D);
-        glEnable(GL_DEPTH_TEST);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glVertexPointer(3, GL_FLOAT, sizeof(BatchVertex), &m_vertices[0].x);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(BatchVertex), &m_vertices[0].u);
+        glDrawArrays(GL_QUADS, 0, static_cast<GLsizei>(m_vertices.size()));
 
+        glPopClientAttrib();
         glPopAttrib();
-        glPopMatrix();
 
-        return true;
+        m_vertices.clear();
+    }
+
+      // Sprites plotted between beginStaticLayer() and endStaticLayer() are
+      // recorded into a display list, which drawStaticLayer() then replays
+      // each frame without re-plotting them
+    void beginStaticLayer()
+    {
+        beginBatch();
+    }
+
+    void endStaticLayer()
+    {
+        if (m_staticLayerList == 0)
+            m_staticLayerList = glGenLists(1);
+
+        glNewList(m_staticLayerList, GL_COMPILE);
+        flushBatch();
+        glEndList();
+    }
+
+    void drawStaticLayer() const
+    {
+        if (m_staticLayerList != 0)
+            glCallList(m_staticLayerList);
     }
 
     ~SpriteManager()
     {
-        for (auto it = m_imageMap.begin(); it != m_imageMap.end(); it++)
-            glDeleteTextures(1, &it->second);
+        if (m_staticLayerList != 0)
+            glDeleteLists(m_staticLayerList, 1);
+        if (m_atlasTexture != 0)
+            glDeleteTextures(1, &m_atlasTexture);
     }
 
 private:
 
-    std::map<int, GLuint>   m_imageMap;
-    std::map<int, int>      m_frameCountPerSprite;
-    bool                    m_mipMapped;
+      // Benchmarks/SpriteBenchmark.cpp replays the old std::map lookup on
+      // top of the same atlas and vertex code
+    friend class SpriteBenchmark;
+
+    struct BatchVertex
+    {
+        GLfloat x, y, z;
+        GLfloat u, v;
+    };
+
+    struct SpriteImage
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;  // BGRA, bottom row first as stored in the TGA
+    };
+
+    struct AtlasRegion
+    {
+        bool    loaded = false;
+        GLfloat u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+    };
+
+    std::vector<AtlasRegion>    m_regions;          // indexed by imageID * m_framesPerImage + frame
+    int                         m_numImages = 0;
+    int                         m_framesPerImage = 0;
+    std::vector<int>            m_frameCounts;      // indexed by imageID
+    std::map<int, SpriteImage>  m_images;           // frames waiting for buildAtlas()
+    GLuint                      m_atlasTexture = 0;
+    GLuint                      m_staticLayerList = 0;
+    bool                        m_mipMapped;
+    std::vector<BatchVertex>    m_vertices;
+
+    static const int ATLAS_WIDTH = 1024;
+    static const int ATLAS_PADDING = 8;
 
     static const int INVALID_SPRITE_ID = -1;
     static const int MAX_IMAGES = 1000;
@@ -235,6 +395,36 @@ private:
         yout = y * cos(theta) + x * sin(theta);
     }
 
+      // Corners of a sprite quad centered on the origin, in the order lower
+      // left, lower right, upper right, upper left of the texture.  Rotate
+      // sprite.  For 180 degrees, don't rotate, but reflect.
+    static void orientedCorners(int angleDegrees, double halfWidth, double halfHeight, double corners[4][2])
+    {
+          // For each Direction, each corner as multiples of (halfWidth, halfHeight),
+          // so the four orientations the game uses need no trigonometry per sprite
+        static const double orientations[4][4][4] = {
+            { { -1,  0,  0, -1 }, {  1,  0,  0, -1 }, {  1,  0,  0,  1 }, { -1,  0,  0,  1 } },  //   0
+            { {  0,  1, -1,  0 }, {  0,  1,  1,  0 }, {  0, -1,  1,  0 }, {  0, -1, -1,  0 } },  //  90
+            { {  1,  0,  0, -1 }, { -1,  0,  0, -1 }, { -1,  0,  0,  1 }, {  1,  0,  0,  1 } },  // 180, reflected
+            { {  0, -1,  1,  0 }, {  0, -1, -1,  0 }, {  0,  1, -1,  0 }, {  0,  1,  1,  0 } },  // 270
+        };
+
+        if (angleDegrees % 90 == 0  &&  angleDegrees >= 0  &&  angleDegrees < 360)
+        {
+            const double (*o)[4] = orientations[angleDegrees / 90];
+            for (int k = 0; k < 4; k++)
+            {
+                corners[k][0] = o[k][0] * halfWidth + o[k][1] * halfHeight;
+                corners[k][1] = o[k][2] * halfWidth + o[k][3] * halfHeight;
+            }
+            return;
+        }
+
+        static const double signs[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+        for (int k = 0; k < 4; k++)
+            rotate(signs[k][0] * halfWidth, signs[k][1] * halfHeight, angleDegrees, corners[k][0], corners[k][1]);
+    }
+
     static void convertToGlutCoords(double x, double y, double& gx, double& gy, double& gz)
     {
         x /= VIEW_WIDTH;
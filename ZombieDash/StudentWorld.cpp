@@ -2,10 +2,16 @@
 #include "Actor.h"
 #include "GameConstants.h"
 #include "Level.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "Log.h"
+#include <algorithm>
 #include <sstream> 
 #include <string>
 #include <iomanip>
-#include <list>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
 using namespace std;
 
 GameWorld* createStudentWorld(string assetPath)
@@ -15,6 +21,9 @@ GameWorld* createStudentWorld(string assetPath)
 
 // Students:  Add code to this file, StudentWorld.h, Actor.h and Actor.cpp
 
+// How often the actor counts are republished for the metrics endpoint
+const int METRICS_PERIOD_TICKS = 30;
+
 StudentWorld::StudentWorld(string assetPath)
 	: GameWorld(assetPath)
 {
@@ -22,21 +31,28 @@ StudentWorld::StudentWorld(string assetPath)
 
 bool StudentWorld::isAgentMovementBlockedAt(double x, double y, Actor* curActor) const
 {
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
 	{
 		if ((*actorPtr) == curActor) continue;
 		if ((*actorPtr)->blocksMovement())
 		{
-			if ((*actorPtr)->spriteOverlapCheck(x, y)) return true;
+			if ((*actorPtr)->spriteOverlapCheck(x, y))
+			{
+				countQuery(QUERY_MOVEMENT_BLOCKED, actorPtr - m_actors.begin() + 1);
+				return true;
+			}
 		}
 	}
 
+	countQuery(QUERY_MOVEMENT_BLOCKED, m_actors.size());
 	return false;
 }
 
 // Loads the specified level number from the file
 int StudentWorld::loadLevel(int curLevel)
 {
+	TRACE_SCOPE("StudentWorld::loadLevel");
+	ALLOCATION_PHASE(PHASE_LEVEL_LOAD);
 	Level lev(assetPath());
 	ostringstream levelFileStream;
 	levelFileStream.fill('0');
@@ -44,12 +60,21 @@ int StudentWorld::loadLevel(int curLevel)
 	string levelFile = levelFileStream.str();
 	Level::LoadResult result = lev.loadLevel(levelFile);
 	if (result == Level::load_fail_file_not_found)
-		cerr << "Cannot find " << levelFile << " data file" << endl;
+		LOG_ERROR("level", "Cannot find the level data file").field("file", levelFile);
 	else if (result == Level::load_fail_bad_format)
-		cerr << "Your level was improperly formatted" << endl;
+		LOG_ERROR("level", "Your level was improperly formatted").field("file", levelFile);
 	else if (result == Level::load_success)
 	{
-		cerr << "Successfully loaded level" << endl;
+		LOG_INFO("level", "Successfully loaded level").field("level", curLevel);
+		LOG_DEBUG("level", "Level file read").field("file", levelFile);
+		for (int i = 0; i < LEVEL_WIDTH; i++)
+		{
+			for (int j = 0; j < LEVEL_HEIGHT; j++)
+			{
+				m_walkable[j][i] = true;
+			}
+		}
+
 		for (int i = 0; i < LEVEL_WIDTH; i++)
 		{
 			for (int j = 0; j < LEVEL_HEIGHT; j++)
@@ -101,6 +126,8 @@ int StudentWorld::loadLevel(int curLevel)
 				if (actor != nullptr) addActor(actor);
 			}
 		}
+
+		commitCommands(m_tick);
 	}
 
 	return result;
@@ -108,9 +135,17 @@ int StudentWorld::loadLevel(int curLevel)
 
 int StudentWorld::init()
 {
+	TRACE_SCOPE("StudentWorld::init");
 	if (m_level == 100) return GWSTATUS_PLAYER_WON;
 	// Loads level, level loading will allocate all actors for the level
 	m_numCitizens = 0;
+	m_tick = 0;
+	m_statsShown = false;
+#ifdef ZD_TICK_PROFILER
+	m_tickQueries.clear();
+	m_levelQueries.clear();
+#endif
+	m_timers.reset(m_tick);
 	int result = loadLevel(m_level);
 	if (result == Level::load_fail_bad_format)
 	{
@@ -130,31 +165,74 @@ int StudentWorld::init()
 // Calls actor's doSomething(), disposing actors that disappeared during a tick
 int StudentWorld::move()
 {
+	TRACE_SCOPE("StudentWorld::move");
+	ALLOCATION_TICK(m_tickAllocations);
 	Penelope* player = static_cast<Penelope*>(m_actors.front());
 
-	// Call every actor's doSomething() method
-	
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	m_inTick = true;
+#ifdef ZD_TICK_PROFILER
+	m_tickQueries.clear();
+#endif
+
+	// Fire countdowns that expire this tick; an infection may end Penelope's life here
 	{
-		if ((*actorPtr)->isAlive())
+		PROFILE_SECTION(m_profiler, TickProfiler::SECTION_TIMERS);
+		ALLOCATION_PHASE(PHASE_TIMERS);
+		m_timers.advanceTo(m_tick);
+	}
+	if (!player->isAlive())
+	{
+		m_inTick = false;
+		return GWSTATUS_PLAYER_DIED;
+	}
+
+	{
+		PROFILE_SECTION(m_profiler, TickProfiler::SECTION_NAVIGATION);
+		ALLOCATION_PHASE(PHASE_NAVIGATION);
+		updateNavigationFields();
+	}
+
+	// Call doSomething() on the actors in the phase buckets due this tick,
+	// without visiting the others.  Actors spawned along the way wait in the
+	// command buffer, so the buckets stay as they were when the tick began.
+	gatherDueBuckets();
+	for (Actor* a = nextDueActor(); a != nullptr; a = nextDueActor())
+	{
+		if (a->isAlive() && !a->isAsleep())
 		{
-			(*actorPtr)->doSomething();
+			{
+				PROFILE_SECTION(m_profiler, a->kind());
+				ALLOCATION_PHASE(PHASE_ACTOR_UPDATE);
+				a->doSomething();
+			}
 
-			if (!player->isAlive()) return GWSTATUS_PLAYER_DIED;
+			if (!player->isAlive())
+			{
+				m_inTick = false;
+				return GWSTATUS_PLAYER_DIED;
+			}
 
 			if (m_levelFinished)
 			{
+				m_inTick = false;
 				m_level++;
 				playSound(SOUND_LEVEL_FINISHED);
 				return GWSTATUS_FINISHED_LEVEL;
 			}
 		}
 	}
+	m_inTick = false;
 
-	removeDeadActors();
+	{
+		PROFILE_SECTION(m_profiler, TickProfiler::SECTION_CLEANUP);
+		ALLOCATION_PHASE(PHASE_COMMIT);
+		commitCommands(m_tick + 1);
+	}
 
-	string stat = getStatString();
-	setGameStatText(stat);
+	updateStatText();
+	if (m_tick % METRICS_PERIOD_TICKS == 0) publishMetrics();
+
+	m_tick++;
 
 	return GWSTATUS_CONTINUE_GAME;
 }
@@ -162,81 +240,321 @@ int StudentWorld::move()
 // Frees all actors
 void StudentWorld::cleanUp()
 {
-	list<Actor *>::const_iterator actorPtr = m_actors.begin();
-	for (; actorPtr != m_actors.end(); actorPtr++)
+	TRACE_SCOPE("StudentWorld::cleanUp");
+#ifdef ZD_TICK_PROFILER
+	if (!m_actors.empty())
+	{
+		// move() has already moved m_level on if the level was finished
+		ostringstream report;
+		m_profiler.report(report, m_levelFinished ? m_level - 1 : m_level, m_tick);
+		for (int q = 0; q < NUM_QUERIES; q++)
+		{
+			long calls = m_levelQueries.calls[q];
+			if (calls == 0) continue;
+			report << "  " << left << setw(29) << queryName(static_cast<Query>(q)) << right
+				<< setw(9) << calls << " calls " << fixed << setprecision(1)
+				<< setw(9) << static_cast<double>(m_levelQueries.actorsExamined[q]) / calls
+				<< " actors/call" << endl;
+		}
+		Log::writeLines(Log::LEVEL_INFO, "profile", report.str());
+	}
+	m_profiler.reset();
+#endif
+#ifdef ZD_TRACK_ALLOCATIONS
+	if (!m_actors.empty())
+	{
+		ostringstream report;
+		m_tickAllocations.report(report, m_levelFinished ? m_level - 1 : m_level);
+		reportResidentActors(report);
+		Log::writeLines(Log::LEVEL_INFO, "allocations", report.str());
+	}
+	m_tickAllocations.reset();
+#endif
+
+	// Pending callbacks refer to the actors about to be deleted
+	m_timers.reset(m_tick);
+
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	{
+		delete (*actorPtr);
+	}
+
+	for (vector<Actor *>::const_iterator actorPtr = m_pendingSpawns.begin(); actorPtr != m_pendingSpawns.end(); actorPtr++)
 	{
 		delete (*actorPtr);
 	}
 
 	m_actors.clear();
+	m_pendingSpawns.clear();
+	m_pendingDeaths = 0;
+	m_schedules.clear();
+	m_nextUpdateOrder = 0;
+}
+
+#ifdef ZD_TRACK_ALLOCATIONS
+void StudentWorld::reportResidentActors(ostream& os) const
+{
+	int count[NUM_ACTOR_KINDS] = {};
+	size_t bytes[NUM_ACTOR_KINDS] = {};
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	{
+		count[(*actorPtr)->kind()]++;
+		bytes[(*actorPtr)->kind()] += Actor::allocatedSize(*actorPtr);
+	}
+
+	os << "Resident actors, plus " << m_actors.capacity() * sizeof(Actor*) << " bytes of actor list:" << endl;
+	for (int k = 0; k < NUM_ACTOR_KINDS; k++)
+	{
+		if (count[k] == 0) continue;
+		os << "  " << left << setw(12) << actorKindName(k) << right
+			<< setw(6) << count[k] << " actors" << setw(9) << bytes[k] << " bytes" << endl;
+	}
+}
+#endif
+
+void StudentWorld::publishMetrics()
+{
+	if (!Metrics().isServing()) return;
+
+	if (m_citizensLeftMetric == nullptr)
+	{
+		for (int k = 0; k < NUM_ACTOR_KINDS; k++)
+		{
+			m_actorMetrics[k] = &Metrics().gauge("zombiedash_actors", k == 0 ? "Actors in the level by kind" : "",
+				string("kind=\"") + actorKindName(k) + "\"");
+		}
+		m_citizensLeftMetric = &Metrics().gauge("zombiedash_citizens_left", "Citizens still to be saved or lost on this level");
+		m_pendingTimersMetric = &Metrics().gauge("zombiedash_pending_timers", "Countdowns waiting in the timer wheel");
+	}
+
+	int count[NUM_ACTOR_KINDS] = {};
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	{
+		count[(*actorPtr)->kind()]++;
+	}
+	for (int k = 0; k < NUM_ACTOR_KINDS; k++)
+	{
+		m_actorMetrics[k]->set(count[k]);
+	}
+	m_citizensLeftMetric->set(m_numCitizens);
+	m_pendingTimersMetric->set(m_timers.pendingCount());
 }
 
 void StudentWorld::addActor(Actor* a)
 {
-	m_actors.push_back(a);
+	ALLOCATION_PHASE(PHASE_SPAWN);
+	m_pendingSpawns.push_back(a);
 }
 
+void StudentWorld::recordActorDead()
+{
+	m_pendingDeaths++;
+}
+
+TimerWheel::TimerID StudentWorld::scheduleTimer(int delay, TimerWheel::Callback callback)
+{
+	return m_timers.schedule(m_tick + delay, callback);
+}
+
+TimerWheel::TimerID StudentWorld::scheduleTimerAfterSpawn(int delay, TimerWheel::Callback callback)
+{
+	return m_timers.schedule(spawnTick() + delay, callback);
+}
+
+void StudentWorld::cancelTimer(TimerWheel::TimerID id)
+{
+	m_timers.cancel(id);
+}
+
+// Only used while loading a level, before any commands are buffered
 void StudentWorld::addActorToFront(Actor* a)
 {
-	m_actors.push_front(a);
+	ALLOCATION_PHASE(PHASE_SPAWN);
+	m_actors.insert(m_actors.begin(), a);
+	scheduleActor(a, m_tick);
 }
 
-void StudentWorld::removeDeadActors()
+// The first call lands on firstTick and later ones every period ticks after
+// it, just as if the actor counted its own time alive
+void StudentWorld::scheduleActor(Actor* a, int firstTick)
 {
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	int period = a->updatePeriod();
+	vector<UpdateSchedule>::iterator schedule = m_schedules.begin();
+	while (schedule != m_schedules.end() && schedule->period != period)
 	{
-		if (!(*actorPtr)->isAlive())
+		schedule++;
+	}
+	if (schedule == m_schedules.end())
+	{
+		m_schedules.push_back(UpdateSchedule{ period, vector<vector<Actor *>>(period) });
+		schedule = m_schedules.end() - 1;
+	}
+
+	schedule->phases[firstTick % period].push_back(a);
+	a->setUpdateOrder(m_nextUpdateOrder++);
+}
+
+void StudentWorld::gatherDueBuckets()
+{
+	m_dueBuckets.clear();
+	for (vector<UpdateSchedule>::const_iterator schedule = m_schedules.begin(); schedule != m_schedules.end(); schedule++)
+	{
+		const vector<Actor *>& bucket = schedule->phases[m_tick % schedule->period];
+		if (!bucket.empty())
 		{
-			delete (*actorPtr);
-			actorPtr = m_actors.erase(actorPtr);
+			m_dueBuckets.push_back(&bucket);
+		}
+	}
+	m_dueNext.assign(m_dueBuckets.size(), 0);
+}
+
+// There are only ever a few due buckets (one per period in use), so the
+// merge simply compares the heads of all of them
+Actor* StudentWorld::nextDueActor()
+{
+	Actor* next = nullptr;
+	size_t nextBucket = 0;
+	for (size_t b = 0; b < m_dueBuckets.size(); b++)
+	{
+		if (m_dueNext[b] == m_dueBuckets[b]->size()) continue;
+
+		Actor* head = (*m_dueBuckets[b])[m_dueNext[b]];
+		if (next == nullptr || head->updateOrder() < next->updateOrder())
+		{
+			next = head;
+			nextBucket = b;
 		}
+	}
 
-		if (actorPtr == m_actors.end()) return;
+	if (next != nullptr)
+	{
+		m_dueNext[nextBucket]++;
 	}
+	return next;
 }
 
-string StudentWorld::getStatString()
+// Spawns made during a tick join on the following one, those made while
+// loading a level join before its first tick
+int StudentWorld::spawnTick() const
 {
-	ostringstream statString;
-	Penelope* player = static_cast<Penelope*>(m_actors.front());
+	return m_inTick ? m_tick + 1 : m_tick;
+}
 
-	statString.fill('0');
-	int score = getScore();
-	if (score < 0)
+// Removes the actors that died during the tick, then appends the ones spawned
+// during it in a single batch, scheduled to first act on firstTick
+void StudentWorld::commitCommands(int firstTick)
+{
+	if (m_pendingDeaths > 0)
 	{
-		statString << "Score: " << "-" << setw(5) << abs(score) << "  ";
+		removeDeadActors();
+		m_pendingDeaths = 0;
 	}
-	else
+
+	if (m_pendingSpawns.empty()) return;
+
+	m_actors.reserve(m_actors.size() + m_pendingSpawns.size());
+	for (vector<Actor *>::const_iterator actorPtr = m_pendingSpawns.begin(); actorPtr != m_pendingSpawns.end(); actorPtr++)
 	{
-		statString << "Score: " << setw(6) << getScore() << "  ";
+		Actor* a = *actorPtr;
+
+		// Spawned and killed within the same tick
+		if (!a->isAlive())
+		{
+			delete a;
+			continue;
+		}
+
+		m_actors.push_back(a);
+		scheduleActor(a, firstTick);
+
+		// Walls are laid down with the level, pits also appear when landmines
+		// explode, and the next tick's distance fields will route around them
+		if (a->blocksPathing())
+		{
+			m_walkable[rowOf(a->getY())][columnOf(a->getX())] = false;
+		}
 	}
-	statString << "Level: " << m_level << "  ";
-	statString << "Lives: " << getLives() << "  ";
-	statString << "Vacc: " << player->getNumVaccines() << "  ";
-	statString << "Flames: " << player->getNumFlameCharges() << "  ";
-	statString << "Mines: " << player->getNumLandmines() << "  ";
-	statString << "Infected: " << player->infectionCount() << " ";
-	string str = statString.str();
-	return str;
+	m_pendingSpawns.clear();
+}
+
+void StudentWorld::removeDeadActors()
+{
+	TRACE_SCOPE("StudentWorld::removeDeadActors");
+	// Drop the dead from their phase buckets while they can still be asked
+	for (vector<UpdateSchedule>::iterator schedule = m_schedules.begin(); schedule != m_schedules.end(); schedule++)
+	{
+		for (vector<vector<Actor *>>::iterator bucket = schedule->phases.begin(); bucket != schedule->phases.end(); bucket++)
+		{
+			bucket->erase(remove_if(bucket->begin(), bucket->end(), [](const Actor* a) { return !a->isAlive(); }), bucket->end());
+		}
+	}
+
+	// Compact the survivors towards the front, keeping their order
+	vector<Actor *>::iterator survivor = m_actors.begin();
+	for (vector<Actor *>::iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	{
+		if ((*actorPtr)->isAlive())
+		{
+			*survivor++ = *actorPtr;
+		}
+		else
+		{
+			delete (*actorPtr);
+		}
+	}
+	m_actors.erase(survivor, m_actors.end());
+}
+
+void StudentWorld::updateStatText()
+{
+	ALLOCATION_PHASE(PHASE_STAT_TEXT);
+	Penelope* player = static_cast<Penelope*>(m_actors.front());
+	StatValues stats = { getScore(), m_level, getLives(), player->getNumVaccines(),
+		player->getNumFlameCharges(), player->getNumLandmines(), player->infectionCount() };
+
+	if (m_statsShown && stats == m_shownStats) return;
+	m_shownStats = stats;
+	m_statsShown = true;
+
+	// Scores are zero padded to six characters, including the sign
+	char statText[160];
+	snprintf(statText, sizeof(statText),
+		"Score: %s%0*d  Level: %d  Lives: %d  Vacc: %d  Flames: %d  Mines: %d  Infected: %d ",
+		stats.score < 0 ? "-" : "", stats.score < 0 ? 5 : 6, abs(stats.score), stats.level, stats.lives,
+		stats.vaccines, stats.flames, stats.mines, stats.infected);
+	setGameStatText(statText);
 }
 
-// Is there an actor at x,y?
+// Is there an actor at x,y?  Actors spawned earlier in this tick count
+// too, after the others, just as if they had been appended to m_actors
 Actor* StudentWorld::findActorAt(double x, double y) const
 {
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
 	{
 		if ((*actorPtr)->spriteOverlapCheck(x, y))
 		{
+			countQuery(QUERY_FIND_ACTOR_AT, actorPtr - m_actors.begin() + 1);
 			return (*actorPtr);
 		}
 	}
 
+	for (vector<Actor *>::const_iterator actorPtr = m_pendingSpawns.begin(); actorPtr != m_pendingSpawns.end(); actorPtr++)
+	{
+		if ((*actorPtr)->spriteOverlapCheck(x, y))
+		{
+			countQuery(QUERY_FIND_ACTOR_AT, m_actors.size() + (actorPtr - m_pendingSpawns.begin()) + 1);
+			return (*actorPtr);
+		}
+	}
+
+	countQuery(QUERY_FIND_ACTOR_AT, m_actors.size() + m_pendingSpawns.size());
 	return nullptr;
 }
 
 void StudentWorld::activateOnAppropriateActors(Actor* a)
 {
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	countQuery(QUERY_ACTIVATE, m_actors.size());
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
 	{
 		if ((*actorPtr) == a) continue;
 
@@ -294,9 +612,10 @@ bool StudentWorld::isZombieVomitTriggerAt(double x, double y) const
 // of the human nearest to (x,y).
 bool StudentWorld::locateNearestVomitTrigger(double x, double y, double& otherX, double& otherY, double& distance)
 {
+	countQuery(QUERY_NEAREST_VOMIT_TRIGGER, m_actors.size());
 	bool humanExists = false;
 	double minDistance = 1000; // Arbitrary large number
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
 	{
 		if ((*actorPtr)->triggersZombieVomit())
 		{
@@ -320,26 +639,25 @@ bool StudentWorld::locateNearestVomitTrigger(double x, double y, double& otherX,
 // if it's a zombie, false if a Penelope.
 bool StudentWorld::locateNearestCitizenTrigger(double x, double y, double& otherX, double& otherY, double& distance, bool& isThreat) const
 {
-	bool triggerExists = false;
-	double minDistance = 1000; // Arbitrary large number
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	double zombieX, zombieY, distToZombie;
+	bool zombieExists = nearestOnField(NAV_ZOMBIES, x, y, zombieX, zombieY, distToZombie);
+	bool playerExists = nearestOnField(NAV_PENELOPE, x, y, otherX, otherY, distance);
+	countQuery(QUERY_NEAREST_CITIZEN_TRIGGER, (zombieExists ? 1 : 0) + (playerExists ? 1 : 0));
+
+	// Penelope wins ties, as she is the first trigger in the actor list
+	if (zombieExists && (!playerExists || distToZombie < distance))
 	{
-		if ((*actorPtr)->triggersCitizens())
-		{
-			double distanceToActor = (*actorPtr)->distanceToCenter(x, y);
-			if (minDistance > distanceToActor)
-			{	
-				otherX = (*actorPtr)->getX();
-				otherY = (*actorPtr)->getY();
-				minDistance = distanceToActor;
-			}
-			triggerExists = true;
-		}
+		otherX = zombieX;
+		otherY = zombieY;
+		distance = distToZombie;
+		isThreat = true;
 	}
-	distance = minDistance;
-	isThreat = !(m_actors.front()->isActorAt(otherX, otherY)); // First element of list is Penelope, checks if Penelope is at x,y
-	
-	return triggerExists;
+	else
+	{
+		isThreat = false;
+	}
+
+	return zombieExists || playerExists;
 }
 
 // Return true if there is a living zombie, false otherwise.  If true,
@@ -347,25 +665,127 @@ bool StudentWorld::locateNearestCitizenTrigger(double x, double y, double& other
 // of the one nearest to (x,y).
 bool StudentWorld::locateNearestCitizenThreat(double x, double y, double& otherX, double& otherY, double& distance) const
 {
-	bool zombieExists = false;
-	double minDistance = 1000; // Arbitrary large number
+	bool zombieExists = nearestOnField(NAV_ZOMBIES, x, y, otherX, otherY, distance);
+	countQuery(QUERY_NEAREST_CITIZEN_THREAT, zombieExists ? 1 : 0);
+	return zombieExists;
+}
 
-	for (list<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+bool StudentWorld::locateNearestOnField(NavTarget t, double x, double y, double& otherX, double& otherY, double& distance) const
+{
+	bool found = nearestOnField(t, x, y, otherX, otherY, distance);
+	countQuery(QUERY_NEAREST_ON_FIELD, found ? 1 : 0);
+	return found;
+}
+
+bool StudentWorld::nearestOnField(NavTarget t, double x, double y, double& otherX, double& otherY, double& distance) const
+{
+	const Actor* nearest = m_navFields[t].nearestSourceAt(columnOf(x), rowOf(y));
+	if (nearest == nullptr) return false;
+
+	otherX = nearest->getX();
+	otherY = nearest->getY();
+
+	// Measure the same way the target was picked, so a target just behind a
+	// wall counts as far away as the walk around it
+	int steps = m_navFields[t].distanceAt(columnOf(x), rowOf(y));
+	distance = (steps == 0) ? nearest->distanceToCenter(x, y) : steps * SPRITE_WIDTH;
+	return true;
+}
+
+#ifdef ZD_TICK_PROFILER
+void StudentWorld::countQuery(Query q, long examined) const
+{
+	m_tickQueries.add(q, examined);
+	m_levelQueries.add(q, examined);
+}
+#endif
+
+const char* StudentWorld::queryName(Query q)
+{
+	static const char* const names[NUM_QUERIES] = {
+		"isAgentMovementBlockedAt", "findActorAt", "activateOnAppropriateActors",
+		"locateNearestVomitTrigger", "locateNearestCitizenTrigger",
+		"locateNearestCitizenThreat", "locateNearestOnField"
+	};
+	return names[q];
+}
+
+bool StudentWorld::findFieldDirection(NavTarget t, double x, double y, bool away, int& d, int& alt_d) const
+{
+	const DistanceField& field = m_navFields[t];
+	int col = columnOf(x);
+	int row = rowOf(y);
+	int curDistance = field.distanceAt(col, row);
+
+	// Walled off from every target, or already in the target's cell
+	if (curDistance == DistanceField::UNREACHABLE || (curDistance == 0 && !away)) return false;
+
+	Direction dirs[4] = { GraphObject::right, GraphObject::left, GraphObject::up, GraphObject::down };
+	int colSteps[4] = { 1, -1, 0, 0 };
+	int rowSteps[4] = { 0, 0, 1, -1 };
+	Direction candidates[4];
+	int numCandidates = 0;
+
+	for (int i = 0; i < 4; i++)
 	{
-		if ((*actorPtr)->threatensCitizens())
+		int nextDistance = field.distanceAt(col + colSteps[i], row + rowSteps[i]);
+		if (nextDistance != DistanceField::UNREACHABLE && (away ? nextDistance > curDistance : nextDistance < curDistance))
 		{
-			double distanceToZombie = (*actorPtr)->distanceToCenter(x, y);
-			if (minDistance > distanceToZombie)
-			{
-				otherX = (*actorPtr)->getX();
-				otherY = (*actorPtr)->getY();
-				minDistance = distanceToZombie;
-			}
-			zombieExists = true;
+			candidates[numCandidates++] = dirs[i];
 		}
 	}
 
-	distance = minDistance;
-	return zombieExists;
+	if (numCandidates == 0) return false;
+
+	// Pick between equally good steps at random, like findDirectionTo does
+	int mainDir = randInt(0, numCandidates - 1);
+	d = candidates[mainDir];
+	alt_d = (numCandidates > 1) ? candidates[(mainDir + 1) % numCandidates] : -1;
+	return true;
 }
 
+// Seeds each field from the actors alive at the start of the tick and floods
+// it through the walkable cells, so per-agent queries are a table lookup
+void StudentWorld::updateNavigationFields()
+{
+	for (int t = 0; t < NUM_NAV_TARGETS; t++)
+	{
+		m_navFields[t].clear();
+	}
+
+	for (vector<Actor *>::const_iterator actorPtr = m_actors.begin(); actorPtr != m_actors.end(); actorPtr++)
+	{
+		const Actor* a = *actorPtr;
+		int col = columnOf(a->getX());
+		int row = rowOf(a->getY());
+
+		if (a->threatensCitizens())
+		{
+			m_navFields[NAV_ZOMBIES].addSource(col, row, a);
+		}
+		else if (a->triggersCitizens())
+		{
+			m_navFields[NAV_PENELOPE].addSource(col, row, a);
+		}
+
+		if (a->triggersZombieVomit())
+		{
+			m_navFields[NAV_HUMANS].addSource(col, row, a);
+		}
+	}
+
+	for (int t = 0; t < NUM_NAV_TARGETS; t++)
+	{
+		m_navFields[t].propagate(m_walkable);
+	}
+}
+
+int StudentWorld::columnOf(double x)
+{
+	return static_cast<int>(x + SPRITE_WIDTH / 2) / SPRITE_WIDTH;
+}
+
+int StudentWorld::rowOf(double y)
+{
+	return static_cast<int>(y + SPRITE_HEIGHT / 2) / SPRITE_HEIGHT;
+}
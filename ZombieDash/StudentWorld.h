@@ -3,25 +3,108 @@
 
 #include "GameWorld.h"
 #include "Level.h"
+#include "DistanceField.h"
+#include "TimerWheel.h"
+#include "TickProfiler.h"
+#include "AllocationTracker.h"
 #include <string>
-#include <list>
+#include <vector>
 
 using namespace std;
 // Students:  Add code to this file, StudentWorld.cpp, Actor.h, and Actor.cpp
 class Actor;
+class Metric;
 
 class StudentWorld : public GameWorld
 {
 public:
+	// Distance fields rebuilt at the start of every tick
+	enum NavTarget { NAV_PENELOPE, NAV_ZOMBIES, NAV_HUMANS, NUM_NAV_TARGETS };
+
+	// Spatial queries whose calls and cost are counted
+	enum Query
+	{
+		QUERY_MOVEMENT_BLOCKED,			// isAgentMovementBlockedAt
+		QUERY_FIND_ACTOR_AT,			// findActorAt
+		QUERY_ACTIVATE,					// activateOnAppropriateActors
+		QUERY_NEAREST_VOMIT_TRIGGER,	// locateNearestVomitTrigger
+		QUERY_NEAREST_CITIZEN_TRIGGER,	// locateNearestCitizenTrigger
+		QUERY_NEAREST_CITIZEN_THREAT,	// locateNearestCitizenThreat
+		QUERY_NEAREST_ON_FIELD,			// locateNearestOnField
+		NUM_QUERIES
+	};
+
+	// How many times each query ran and how many actors they looked at in
+	// total.  Queries answered from a distance field look at no more than
+	// the one nearest actor per field read, so a citizen trigger query can
+	// look at two.  Each call is counted once, under the query the actor
+	// made, and not again for the field lookups inside it.
+	struct QueryCounters
+	{
+		long calls[NUM_QUERIES];
+		long actorsExamined[NUM_QUERIES];
+
+		void clear()
+		{
+			for (int q = 0; q < NUM_QUERIES; q++)
+			{
+				calls[q] = 0;
+				actorsExamined[q] = 0;
+			}
+		}
+
+		void add(Query q, long examined)
+		{
+			calls[q]++;
+			actorsExamined[q] += examined;
+		}
+	};
+
 	// Needed
     StudentWorld(std::string assetPath);
     virtual int init();
     virtual int move();
     virtual void cleanUp();
 
-	// Add an actor to the world.
+	// Add an actor to the world.  Actors created during a tick join the world
+	// when the tick's commands are committed and first act on the next tick.
 	void addActor(Actor* a);
 
+	// Record that an actor has died; it is removed when the tick's commands
+	// are committed.
+	void recordActorDead();
+
+	// Ticks elapsed on the current level
+	int currentTick() const { return m_tick; }
+
+	// Number of actors in the level, for the performance overlay
+	virtual int actorCount() const { return static_cast<int>(m_actors.size()); }
+
+#ifdef ZD_TICK_PROFILER
+	// Query counts for the most recent tick, and for the level so far
+	const QueryCounters& tickQueryCounters() const { return m_tickQueries; }
+	const QueryCounters& levelQueryCounters() const { return m_levelQueries; }
+#endif
+
+	// Name of the function behind query q
+	static const char* queryName(Query q);
+
+#ifdef ZD_TRACK_ALLOCATIONS
+	// Allocations made by the most recent tick, and by the level so far
+	const TickAllocations& tickAllocations() const { return m_tickAllocations; }
+#endif
+
+	// Run callback at the start of the tick delay ticks from now, before any
+	// actor moves.  Returns an id that can be passed to cancelTimer.
+	TimerWheel::TimerID scheduleTimer(int delay, TimerWheel::Callback callback);
+
+	// Like scheduleTimer, but delay counts from the first tick on which an
+	// actor created now will act
+	TimerWheel::TimerID scheduleTimerAfterSpawn(int delay, TimerWheel::Callback callback);
+
+	// Stop a timer from firing (harmless if it already has)
+	void cancelTimer(TimerWheel::TimerID id);
+
 	// Record that one more citizen on the current level is gone (exited,
 	// died, or turned into a zombie).
 	void recordCitizenGone();
@@ -54,25 +137,104 @@ public:
 	// Return true if there is a living zombie or Penelope, otherwise false.
 	// If true, otherX, otherY, and distance will be set to the location and
 	// distance of the one nearest to (x,y), and isThreat will be set to true
-	// if it's a zombie, false if a Penelope.
+	// if it's a zombie, false if a Penelope.  Nearest and distance are both
+	// measured along the path through the level, as locateNearestOnField does.
 	bool locateNearestCitizenTrigger(double x, double y, double& otherX, double& otherY, double& distance, bool& isThreat) const;
 
 	// Return true if there is a living zombie, false otherwise.  If true,
 	// otherX, otherY and distance will be set to the location and distance
-	// of the one nearest to (x,y).
+	// of the one nearest to (x,y) by path.
 	bool locateNearestCitizenThreat(double x, double y, double& otherX, double& otherY, double& distance) const;
+
+	// Return true if a target of kind t can be reached from (x,y).  If true,
+	// otherX, otherY and distance will be set to the location of the one
+	// nearest to (x,y) by path and the length of that path in pixels, or the
+	// straight-line distance to it if it shares a cell with (x,y).
+	bool locateNearestOnField(NavTarget t, double x, double y, double& otherX, double& otherY, double& distance) const;
+
+	// Return true if stepping into a neighbouring cell brings (x,y) closer to
+	// the nearest target of kind t, or further from it if away is true.  If
+	// true, d is set to such a direction and alt_d to a second one, or -1 if
+	// there is only one.  Returns false when no target can be reached, or when
+	// heading towards one that already shares a cell with (x,y).
+	bool findFieldDirection(NavTarget t, double x, double y, bool away, int& d, int& alt_d) const;
     ~StudentWorld() { cleanUp(); }
 
 private:
-	string getStatString(); // returns the stat string
+	void updateStatText(); // send the stat line to the game controller if anything on it changed
 	void addActorToFront(Actor* a);
+	void scheduleActor(Actor* a, int firstTick); // place a in the phase bucket for its update period
+	void gatherDueBuckets(); // find the phase buckets due on m_tick
+	Actor* nextDueActor(); // the next actor from the due buckets in update order, or nullptr
+	void commitCommands(int firstTick); // apply the buffered spawns and deaths
+	int spawnTick() const; // first tick on which an actor created now will act
 	Actor* findActorAt(double x, double y) const; // returns actor covering coordinate x, y
+	bool nearestOnField(NavTarget t, double x, double y, double& otherX, double& otherY, double& distance) const; // locateNearestOnField without counting it
 	int loadLevel(int curLevel);
 	void removeDeadActors();
-	list<Actor *> m_actors; // The first element is always penelope
+	void updateNavigationFields(); // rebuild the per-tick distance fields
+	static int columnOf(double x); // grid cell containing a sprite's center
+	static int rowOf(double y);
+#ifdef ZD_TICK_PROFILER
+	void countQuery(Query q, long examined) const; // add one call of q to the tick and level counters
+#else
+	void countQuery(Query, long) const {} // queries are only counted for the profiler
+#endif
+	vector<Actor *> m_actors; // The first element is always penelope
+	vector<Actor *> m_pendingSpawns; // actors created since the last commit
+	int m_pendingDeaths = 0; // actors that died since the last commit
+	bool m_inTick = false; // is move() running?
 	int m_numCitizens = 0; // number of citizens alive
 	bool m_levelFinished; // Is the current level finished?
 	int m_level = 1;
+	int m_tick = 0; // ticks elapsed on the current level
+	TimerWheel m_timers; // countdowns for landmines, projectiles and infections
+
+	// Actors grouped by update period, with one bucket per phase of the
+	// period.  Each bucket keeps its actors in update order, the order they
+	// joined m_actors in, so merging the buckets due on a tick calls them in
+	// the same order a walk over m_actors would.
+	struct UpdateSchedule
+	{
+		int period;
+		vector<vector<Actor *>> phases;
+	};
+	vector<UpdateSchedule> m_schedules;
+	long m_nextUpdateOrder = 0;
+	vector<const vector<Actor *>*> m_dueBuckets; // buckets due this tick, reused to save allocating
+	vector<size_t> m_dueNext; // next actor to call in each due bucket
+	bool m_walkable[LEVEL_HEIGHT][LEVEL_WIDTH]; // cells not occupied by a wall or pit, kept up to date by commitCommands
+	DistanceField m_navFields[NUM_NAV_TARGETS];
+#ifdef ZD_TICK_PROFILER
+	TickProfiler m_profiler; // time per actor kind and tick phase on the current level
+	mutable QueryCounters m_tickQueries; // counted from inside const queries
+	mutable QueryCounters m_levelQueries;
+#endif
+#ifdef ZD_TRACK_ALLOCATIONS
+	TickAllocations m_tickAllocations; // heap allocations made by each tick of the current level
+	void reportResidentActors(std::ostream& os) const; // bytes held by each kind of actor
+#endif
+
+	// Values last shown on the stat line, so it is only rebuilt when one changes
+	struct StatValues
+	{
+		int score, level, lives, vaccines, flames, mines, infected;
+
+		bool operator==(const StatValues& other) const
+		{
+			return score == other.score && level == other.level && lives == other.lives &&
+				vaccines == other.vaccines && flames == other.flames && mines == other.mines &&
+				infected == other.infected;
+		}
+	};
+	StatValues m_shownStats;
+	bool m_statsShown = false; // has the stat line been sent since the level started?
+
+	// Actor counts and queue depths for the metrics endpoint, when the game serves one
+	void publishMetrics();
+	Metric* m_actorMetrics[NUM_ACTOR_KINDS] = {};
+	Metric* m_citizensLeftMetric = nullptr;
+	Metric* m_pendingTimersMetric = nullptr;
 };
 
 #endif // STUDENTWORLD_H_
@@ -0,0 +1,54 @@
+#include "TickProfiler.h"
+#include <iomanip>
+
+namespace
+{
+	const char* const SECTION_NAMES[TickProfiler::NUM_SECTIONS - NUM_ACTOR_KINDS] = {
+		"timers", "navigation", "cleanup"
+	};
+
+	const char* sectionName(int section)
+	{
+		return section < NUM_ACTOR_KINDS ? actorKindName(section) : SECTION_NAMES[section - NUM_ACTOR_KINDS];
+	}
+}
+
+void TickProfiler::reset()
+{
+	for (int i = 0; i < NUM_SECTIONS; i++)
+	{
+		m_elapsed[i] = Clock::duration::zero();
+		m_calls[i] = 0;
+	}
+}
+
+void TickProfiler::add(int section, Clock::duration elapsed)
+{
+	m_elapsed[section] += elapsed;
+	m_calls[section]++;
+}
+
+void TickProfiler::report(std::ostream& os, int level, int ticks) const
+{
+	Clock::duration total = Clock::duration::zero();
+	for (int i = 0; i < NUM_SECTIONS; i++)
+	{
+		total += m_elapsed[i];
+	}
+	double totalMs = std::chrono::duration<double, std::milli>(total).count();
+
+	os << "Tick profile for level " << level << " over " << ticks << " ticks:" << std::endl;
+	os << std::fixed;
+	for (int i = 0; i < NUM_SECTIONS; i++)
+	{
+		if (m_calls[i] == 0) continue;
+
+		double ms = std::chrono::duration<double, std::milli>(m_elapsed[i]).count();
+		os << "  " << std::left << std::setw(12) << sectionName(i) << std::right
+			<< std::setprecision(3) << std::setw(10) << ms << " ms"
+			<< std::setw(9) << m_calls[i] << " calls"
+			<< std::setprecision(0) << std::setw(10) << 1e6 * ms / m_calls[i] << " ns/call"
+			<< std::setprecision(1) << std::setw(7) << (totalMs > 0 ? 100 * ms / totalMs : 0) << "%" << std::endl;
+	}
+	os.unsetf(std::ios::floatfield);
+}
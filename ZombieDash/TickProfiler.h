@@ -0,0 +1,63 @@
+#ifndef TICKPROFILER_H_
+#define TICKPROFILER_H_
+
+#include "ActorKind.h"
+#include <chrono>
+#include <ostream>
+
+// Accumulates time and call counts for each part of StudentWorld::move(): one
+// section per kind of actor, plus the timer wheel, the navigation fields and
+// the cleanup of dead actors.  Only built when ZD_TICK_PROFILER is defined;
+// otherwise PROFILE_SECTION expands to nothing.
+class TickProfiler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	enum Section
+	{
+		SECTION_TIMERS = NUM_ACTOR_KINDS,
+		SECTION_NAVIGATION,
+		SECTION_CLEANUP,
+		NUM_SECTIONS
+	};
+
+	TickProfiler() { reset(); }
+
+	// Forget everything recorded so far
+	void reset();
+
+	void add(int section, Clock::duration elapsed);
+
+	// Write a table of the time spent in each section since the last reset
+	void report(std::ostream& os, int level, int ticks) const;
+
+	// Charges the time from its construction to its destruction to a section
+	class Scope
+	{
+	public:
+		Scope(TickProfiler& profiler, int section) :
+			m_profiler(profiler), m_section(section), m_start(Clock::now())
+		{}
+		~Scope() { m_profiler.add(m_section, Clock::now() - m_start); }
+	private:
+		TickProfiler& m_profiler;
+		int m_section;
+		Clock::time_point m_start;
+	};
+
+private:
+	Clock::duration m_elapsed[NUM_SECTIONS];
+	long m_calls[NUM_SECTIONS];
+};
+
+#ifdef ZD_TICK_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SECTION(profiler, section) \
+	TickProfiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(profiler, section)
+#else
+#define PROFILE_SECTION(profiler, section) ((void)0)
+#endif
+
+#endif // TICKPROFILER_H_
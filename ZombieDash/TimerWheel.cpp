@@ -0,0 +1,150 @@
+#include "TimerWheel.h"
+#include <utility>
+
+void TimerWheel::reset(int tick)
+{
+	m_pool.clear();
+	m_free.clear();
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		m_slotHeads[i] = NONE;
+	}
+	m_nextTick = tick;
+	m_pendingCount = 0;
+}
+
+TimerWheel::TimerID TimerWheel::schedule(int dueTick, Callback callback)
+{
+	int index;
+	if (!m_free.empty())
+	{
+		index = m_free.back();
+		m_free.pop_back();
+	}
+	else
+	{
+		index = static_cast<int>(m_pool.size());
+		m_pool.push_back(Timer{ 0, nullptr, 0, NONE, NONE, NONE });
+	}
+
+	Timer& t = m_pool[index];
+	t.dueTick = dueTick;
+	t.callback = std::move(callback);
+	insert(index);
+	m_pendingCount++;
+
+	return (t.generation << INDEX_BITS) | index;
+}
+
+void TimerWheel::cancel(TimerID id)
+{
+	if (id == NO_TIMER) return;
+
+	int index = id & ((1 << INDEX_BITS) - 1);
+	int generation = id >> INDEX_BITS;
+	if (index >= static_cast<int>(m_pool.size())) return;
+
+	// Already fired, cancelled, or the slot now belongs to a newer timer
+	if (m_pool[index].slot == NONE || m_pool[index].generation != generation) return;
+
+	unlink(index);
+	release(index);
+}
+
+void TimerWheel::advanceTo(int tick)
+{
+	while (m_nextTick <= tick)
+	{
+		// Entering a new block of WHEEL_SIZE ticks, so bring its timers down
+		// from the outer wheel before firing the first of them
+		if ((m_nextTick & (WHEEL_SIZE - 1)) == 0)
+		{
+			cascade(WHEEL_SIZE + ((m_nextTick >> WHEEL_BITS) & (WHEEL_SIZE - 1)));
+		}
+
+		fireSlot(m_nextTick & (WHEEL_SIZE - 1));
+		m_nextTick++;
+	}
+}
+
+// Places a timer in the inner wheel if it is due within WHEEL_SIZE ticks,
+// otherwise in the outer wheel slot for its block.  Timers too far out for the
+// outer wheel simply go round again when their slot is cascaded.
+void TimerWheel::insert(int index)
+{
+	Timer& t = m_pool[index];
+	int due = (t.dueTick < m_nextTick) ? m_nextTick : t.dueTick;
+
+	if (due - m_nextTick < WHEEL_SIZE)
+	{
+		t.slot = due & (WHEEL_SIZE - 1);
+	}
+	else
+	{
+		t.slot = WHEEL_SIZE + ((due >> WHEEL_BITS) & (WHEEL_SIZE - 1));
+	}
+
+	t.prev = NONE;
+	t.next = m_slotHeads[t.slot];
+	if (t.next != NONE)
+	{
+		m_pool[t.next].prev = index;
+	}
+	m_slotHeads[t.slot] = index;
+}
+
+void TimerWheel::unlink(int index)
+{
+	Timer& t = m_pool[index];
+	if (t.prev != NONE)
+	{
+		m_pool[t.prev].next = t.next;
+	}
+	else
+	{
+		m_slotHeads[t.slot] = t.next;
+	}
+
+	if (t.next != NONE)
+	{
+		m_pool[t.next].prev = t.prev;
+	}
+}
+
+void TimerWheel::release(int index)
+{
+	Timer& t = m_pool[index];
+	t.callback = nullptr;
+	t.slot = NONE;
+	t.generation = (t.generation + 1) & 0x7fff;
+	m_free.push_back(index);
+	m_pendingCount--;
+}
+
+void TimerWheel::fireSlot(int slot)
+{
+	// Callbacks may schedule or cancel other timers, including ones in this
+	// slot, so take one timer at a time off the front of the list
+	while (m_slotHeads[slot] != NONE)
+	{
+		int index = m_slotHeads[slot];
+		unlink(index);
+		Callback callback = std::move(m_pool[index].callback);
+		release(index);
+		callback();
+	}
+}
+
+void TimerWheel::cascade(int outerSlot)
+{
+	// Detach the whole list first, as far-off timers are reinserted into this same slot
+	int index = m_slotHeads[outerSlot];
+	m_slotHeads[outerSlot] = NONE;
+
+	while (index != NONE)
+	{
+		int next = m_pool[index].next;
+		insert(index);
+		index = next;
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+#include <functional>
+#include <vector>
+
+// Hierarchical timer wheel keyed on game ticks.  The inner wheel holds timers
+// due within the next WHEEL_SIZE ticks, one slot per tick; the outer wheel holds
+// later ones, one slot per WHEEL_SIZE ticks, and is cascaded into the inner
+// wheel as time reaches each of its slots.  Scheduling, cancelling and firing
+// are all constant time per timer.
+class TimerWheel
+{
+public:
+	typedef std::function<void()> Callback;
+	typedef int TimerID;
+	static const TimerID NO_TIMER = -1;
+
+	TimerWheel() { reset(0); }
+
+	// Drop every pending timer and restart the clock at tick
+	void reset(int tick);
+
+	// Arrange for callback to run when the clock reaches dueTick.  Timers
+	// already due fire on the next call to advanceTo().
+	TimerID schedule(int dueTick, Callback callback);
+
+	// Stop a pending timer from firing.  Harmless for timers that already fired.
+	void cancel(TimerID id);
+
+	// Fire, in order of due tick, every timer due at or before tick
+	void advanceTo(int tick);
+
+	// Number of timers waiting to fire
+	int pendingCount() const { return m_pendingCount; }
+
+private:
+	static const int WHEEL_BITS = 6;
+	static const int WHEEL_SIZE = 1 << WHEEL_BITS;
+	static const int NUM_SLOTS = 2 * WHEEL_SIZE; // inner wheel, then outer wheel
+	static const int INDEX_BITS = 16;            // low bits of a TimerID index the pool
+	static const int NONE = -1;
+
+	struct Timer
+	{
+		int dueTick;
+		Callback callback;
+		int generation; // bumped on reuse so stale TimerIDs are ignored
+		int slot;       // NONE while the timer is free
+		int prev;
+		int next;
+	};
+
+	void insert(int index);
+	void unlink(int index);
+	void release(int index);
+	void fireSlot(int slot);
+	void cascade(int outerSlot);
+
+	std::vector<Timer> m_pool;
+	std::vector<int> m_free;
+	int m_slotHeads[NUM_SLOTS];
+	int m_nextTick;     // earliest tick that has not been processed yet
+	int m_pendingCount;
+};
+
+#endif // TIMERWHEEL_H_
@@ -0,0 +1,135 @@
+#include "Trace.h"
+#include "Log.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char*             name;
+        Trace::Clock::time_point start;
+        Trace::Clock::duration  duration;
+    };
+
+      // The events recorded by one thread.  They are kept in fixed-size
+      // blocks, so appending never stops to copy everything recorded so far.
+    struct ThreadBuffer
+    {
+        static const size_t BLOCK_SIZE = 8192;
+
+        int     threadNumber;
+        vector<unique_ptr<TraceEvent[]>> blocks;
+        size_t  usedInLastBlock = BLOCK_SIZE;
+
+        void append(const TraceEvent& event)
+        {
+            if (usedInLastBlock == BLOCK_SIZE)
+            {
+                blocks.emplace_back(new TraceEvent[BLOCK_SIZE]);
+                usedInLastBlock = 0;
+            }
+            blocks.back()[usedInLastBlock++] = event;
+        }
+
+        void clear()
+        {
+            blocks.clear();
+            usedInLastBlock = BLOCK_SIZE;
+        }
+    };
+
+      // The buffers belong here rather than to their threads, so that events
+      // from threads that have already finished still get written
+    struct Registry
+    {
+        mutex   lock;               // only taken when a thread records its first event, and by stop()
+        vector<unique_ptr<ThreadBuffer>> buffers;
+        string  path;
+        Trace::Clock::time_point origin;
+    };
+
+    Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    ThreadBuffer& threadBuffer()
+    {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr)
+        {
+            Registry& r = registry();
+            lock_guard<mutex> guard(r.lock);
+            r.buffers.emplace_back(new ThreadBuffer);
+            buffer = r.buffers.back().get();
+            buffer->threadNumber = static_cast<int>(r.buffers.size());
+        }
+        return *buffer;
+    }
+
+    double microseconds(Trace::Clock::duration d)
+    {
+        return chrono::duration<double, micro>(d).count();
+    }
+}
+
+void Trace::start(const string& path)
+{
+    Registry& r = registry();
+    {
+        lock_guard<mutex> guard(r.lock);
+        for (auto& buffer : r.buffers)
+            buffer->clear();
+        r.path = path;
+        r.origin = Clock::now();
+    }
+    recording().store(true, memory_order_relaxed);
+}
+
+void Trace::stop()
+{
+    if (!isRecording())
+        return;
+    recording().store(false, memory_order_relaxed);
+
+    Registry& r = registry();
+    lock_guard<mutex> guard(r.lock);
+    ofstream out(r.path);
+    if (!out)
+    {
+        LOG_ERROR("trace", "Cannot write the trace file").field("file", r.path);
+        return;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+        << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"ZombieDash\"}}";
+    char line[256];
+    for (auto& buffer : r.buffers)
+    {
+        for (size_t b = 0; b < buffer->blocks.size(); b++)
+        {
+            size_t used = (b + 1 == buffer->blocks.size() ? buffer->usedInLastBlock : ThreadBuffer::BLOCK_SIZE);
+            for (size_t i = 0; i < used; i++)
+            {
+                const TraceEvent& e = buffer->blocks[b][i];
+                snprintf(line, sizeof(line),
+                         ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                         e.name, buffer->threadNumber, microseconds(e.start - r.origin), microseconds(e.duration));
+                out << line;
+            }
+        }
+        buffer->clear();
+    }
+    out << "\n]}\n";
+}
+
+void Trace::addEvent(const char* name, Clock::time_point start, Clock::time_point end)
+{
+    threadBuffer().append(TraceEvent{ name, start, end - start });
+}
@@ -0,0 +1,76 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+  // Records when named stretches of work start and how long they take, so a
+  // whole session can be opened in chrome://tracing or Perfetto.  Nothing is
+  // recorded until start() is called.  Each thread appends to a buffer of its
+  // own without locking, and stop() writes everything out as Chrome
+  // trace-event JSON.
+class Trace
+{
+  public:
+
+    using Clock = std::chrono::steady_clock;
+
+      // Begin recording, to be written to path by stop()
+    static void start(const std::string& path);
+
+      // Write the trace file and stop recording.  No other thread may still
+      // be recording when this is called.
+    static void stop();
+
+    static bool isRecording()
+    {
+        return recording().load(std::memory_order_relaxed);
+    }
+
+      // name must be a string literal, or otherwise outlive the trace, and
+      // must not need escaping in JSON
+    static void addEvent(const char* name, Clock::time_point start, Clock::time_point end);
+
+      // Records the time from its construction to its destruction
+    class Scope
+    {
+      public:
+
+        explicit Scope(const char* name)
+         : m_name(isRecording() ? name : nullptr)
+        {
+            if (m_name != nullptr)
+                m_start = Clock::now();
+        }
+
+        ~Scope()
+        {
+            if (m_name != nullptr)
+                addEvent(m_name, m_start, Clock::now());
+        }
+
+          // Prevent copying or assigning Scopes
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+      private:
+
+        const char*         m_name;     // nullptr if not recording
+        Clock::time_point   m_start;
+    };
+
+  private:
+
+    static std::atomic<bool>& recording()
+    {
+        static std::atomic<bool> on(false);
+        return on;
+    }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif // TRACE_H_
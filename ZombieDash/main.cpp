@@ -1,5 +1,5 @@
 #include "GameController.h"
-#include <iostream>
+#include "Log.h"
 #include <fstream>
 #include <string>
 using namespace std;
@@ -37,7 +37,7 @@ int main(int argc, char* argv[])
     {
         if (!is_directory(assetPath))
         {
-            cout << "Cannot find directory " << assetPath << endl;
+            LOG_ERROR("main", "Cannot find the asset directory").field("directory", assetPath);
             return 1;
         }
         assetPath += '/';
@@ -47,8 +47,9 @@ int main(int argc, char* argv[])
         ifstream ifs(assetPath + someAsset);
         if (!ifs)
         {
-            cout << "Cannot find " << someAsset << " in ";
-            cout << (assetDirectory.empty() ? "current directory" : assetDirectory) << endl;
+            LOG_ERROR("main", "Cannot find a level file")
+                .field("file", someAsset)
+                .field("directory", assetDirectory.empty() ? "current directory" : assetDirectory);
             return 1;
         }
     }